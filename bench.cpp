@@ -0,0 +1,193 @@
+#include <iostream>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "mylib/DeviceLibrary.cpp"
+#include "mylib/Kit6502.cpp"
+
+// Emulator throughput: every workload runs a fixed number of emulated cycles on a fresh kit and
+// reports host nanoseconds per cycle, emulated instructions per second and how much of the time
+// is the device loop itself (virtual calls, bus and clock handling without any device work).
+//
+//   g++ -O2 -o bench bench.cpp -pthread
+//   bench [--cycles N] [--reps N] [--threads N] [--only NAME] [--csv | --json]
+//
+// Engines: "kit" evaluates the whole device list, "core" only the CPU and the memory path
+// (Pal, Splitter, ROM, RAM). Programs that need the ports run on "kit" only.
+
+using namespace std;
+
+//======================================== Workloads ======================================
+
+struct Workload {
+	const char *Name;
+	const char *Prog;                  // program file loaded at $0200, NULL: kernel or monitor
+	uint8_t Kernel[8]; int KernelLen;  // instruction sequence repeated in RAM, 0: none
+	bool Go;                           // start at $0200 instead of the monitor
+	bool NeedsIo;                      // display, keyboard or timer
+};
+
+const Workload Loads[] = {
+	{ "monitor",   NULL,                     {0},                0, false, true  },   // ROM idle loop, keyboard scan
+	{ "bincount",  "resources/PROG_BINCOUNT", {0},               0, true,  false },
+	{ "seg7",      "resources/PROG_SEG7",     {0},               0, true,  true  },
+	{ "timer",     "resources/PROG_TIMER",    {0},               0, true,  true  },
+	{ "k_nop",     NULL, {0xea},                                 1, true,  false },   // NOP
+	{ "k_lda_im",  NULL, {0xa9, 0x55},                           2, true,  false },   // LDA #$55
+	{ "k_lda_ab",  NULL, {0xad, 0x00, 0x07},                     3, true,  false },   // LDA $0700
+	{ "k_sta_ab",  NULL, {0x8d, 0x00, 0x07},                     3, true,  false },   // STA $0700
+	{ "k_adc_zp",  NULL, {0x65, 0x10},                           2, true,  false },   // ADC $10
+	{ "k_inc_zp",  NULL, {0xe6, 0x10},                           2, true,  false },   // INC $10
+	{ "k_lda_iy",  NULL, {0xb1, 0x20},                           2, true,  false },   // LDA ($20),Y
+	{ "k_pha_pla", NULL, {0x48, 0x68},                           2, true,  false },   // PHA PLA
+	{ "k_jsr_rts", NULL, {0x20, 0x00, 0x07},                     3, true,  false },   // JSR $0700 (RTS there)
+	{ "k_dex_bne", NULL, {0xca, 0xd0, 0xfd},                     3, true,  false },   // DEX BNE (taken 255 times)
+};
+const int LoadCount = sizeof(Loads) / sizeof(Loads[0]);
+
+void Prepare(Kit6502 &Kit, const Workload &W, bool core){
+	Kit.LoadSystem("resources/ROM", "resources/PAL");
+	if(W.Prog != NULL){ Kit.LoadProgram(W.Prog, 0x200);}
+
+	if(W.KernelLen != 0){                                  // kernel repeated over 1KB, then JMP $0200
+		int a = 0x200;
+		while(a + W.KernelLen < 0x600){ for(int i = 0; i < W.KernelLen; i++){ Kit.Ram[a++] = W.Kernel[i];}}
+		Kit.Ram[a] = 0x4c; Kit.Ram[a+1] = 0x00; Kit.Ram[a+2] = 0x02;
+		Kit.Ram[0x700] = 0x60;                             // RTS for the JSR kernel (also the LDA/STA target)
+		Kit.Ram[0x20] = 0x00; Kit.Ram[0x21] = 0x08;        // ($20) points at $0800
+	}
+	if(W.Go){ Kit.SetResetVector(0x200);}
+
+	if(core){                                              // CPU and memory path only
+		Device *List[] = { &Kit.Cpu, &Kit.Pal, &Kit.Splt, &Kit.Rom, &Kit.Ram };
+		for(Kit.SystemCount = 0; Kit.SystemCount < 5; Kit.SystemCount++){ Kit.System[Kit.SystemCount] = List[Kit.SystemCount];}
+	}
+}
+
+//======================================== Measuring ======================================
+
+struct Result {
+	double Sec;                        // wall time of the slowest thread
+	unsigned long long Cycles, Insts;  // all threads
+};
+
+void RunOne(const Workload *W, bool core, unsigned long long cycles, unsigned long long *insts, double *sec){
+	Kit6502 Kit;
+	Prepare(Kit, *W, core);
+
+	std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+	for(unsigned long long c = 0; c < cycles; c++){ Kit.Tick(); Kit.Tick();}
+	*sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+	*insts = Kit.Cpu.getInstCount();
+}
+
+Result Run(const Workload &W, bool core, unsigned long long cycles, int threads){
+	vector<std::thread> T;
+	vector<unsigned long long> insts(threads);
+	vector<double> sec(threads);
+
+	for(int i = 0; i < threads; i++){ T.push_back(std::thread(RunOne, &W, core, cycles, &insts[i], &sec[i]));}
+	for(int i = 0; i < threads; i++){ T[i].join();}
+
+	Result R; R.Sec = 0; R.Cycles = cycles * threads; R.Insts = 0;
+	for(int i = 0; i < threads; i++){
+		R.Insts += insts[i];
+		if(sec[i] > R.Sec){ R.Sec = sec[i];}
+	}
+	return R;
+}
+
+// The device loop with nothing in it: the same number of virtual calls per tick as the engine.
+
+class Idle : public Device {
+	public:
+		Idle() : Device(0) {}
+		void Evaluate(){}
+};
+
+double LoopCost(int devices, unsigned long long cycles){          // seconds for the empty loop
+	Idle Nop[32];
+	Device *System[32];
+	Device *volatile *Sys = System;                        // keeps the calls virtual (no inlining of the empty loop)
+	CollectorBitBus Irq;
+	Clock Clk(1,1);
+	for(int i = 0; i < devices; i++){ System[i] = &Nop[i];}
+
+	std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+	for(unsigned long long c = 0; c < cycles*2; c++){
+		Irq.Reset();
+		for(int i = 0; i < devices; i++){ Sys[i]->Evaluate();}
+		Clk++;
+	}
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+
+int main(int argc, char *argv[]){
+
+	unsigned long long Cycles = 2000000;
+	int Reps = 3, Threads = 1, Format = 0;                  // 0 table, 1 csv, 2 json
+	string Only = "";
+
+	for(int i = 1; i < argc; i++){
+		string o = argv[i];
+		bool more = (i + 1 < argc);
+
+		if(o == "--cycles" && more){ Cycles = strtoull(argv[++i], NULL, 10);}
+		else if(o == "--reps" && more){ Reps = atoi(argv[++i]);}
+		else if(o == "--threads" && more){ Threads = atoi(argv[++i]);}
+		else if(o == "--only" && more){ Only = argv[++i];}
+		else if(o == "--csv"){ Format = 1;}
+		else if(o == "--json"){ Format = 2;}
+		else{
+			printf("bench [--cycles N] [--reps N] [--threads N] [--only NAME] [--csv | --json]\n");
+			return 2;
+		}
+	}
+	if(Reps < 1){ Reps = 1;}
+	if(Threads < 1){ Threads = 1;}
+
+	{ Kit6502 Probe; if(!Probe.LoadSystem("resources/ROM", "resources/PAL")){ printf("run from the repository root (resources/)\n"); return 1;}}
+
+	if(Format == 0){ printf("%-10s %-5s %3s %12s %10s %9s %12s %9s\n", "workload", "eng", "thr", "cycles", "ns/cycle", "MIPS", "cycles/s", "loop %");}
+	if(Format == 1){ printf("workload,engine,threads,cycles,instructions,seconds,ns_per_cycle,mips,cycles_per_sec,loop_overhead\n");}
+	if(Format == 2){ printf("[\n");}
+
+	bool first = true;
+	for(int e = 0; e < 2; e++){
+		bool core = (e == 1);
+		double loop = LoopCost(core ? 5 : 17, Cycles);                 // per thread, single core
+
+		for(int w = 0; w < LoadCount; w++){
+			const Workload &W = Loads[w];
+			if(core && W.NeedsIo){ continue;}
+			if(Only != "" && Only != W.Name){ continue;}
+
+			Result best; best.Sec = -1; best.Cycles = best.Insts = 0;
+			for(int r = 0; r < Reps; r++){                              // fastest repetition
+				Result R = Run(W, core, Cycles, Threads);
+				if(best.Sec < 0 || R.Sec < best.Sec){ best = R;}
+			}
+
+			double ns = best.Sec * 1e9 / (double(best.Cycles) / Threads);   // per cycle and thread
+			double mips = best.Insts / best.Sec / 1e6;
+			double cps = best.Cycles / best.Sec;
+			double over = loop / (best.Sec > 0 ? best.Sec : 1) * 100.0;
+			const char *eng = core ? "core" : "kit";
+
+			if(Format == 0){ printf("%-10s %-5s %3d %12llu %10.2f %9.3f %12.0f %8.1f%%\n", W.Name, eng, Threads, best.Cycles, ns, mips, cps, over);}
+			if(Format == 1){ printf("%s,%s,%d,%llu,%llu,%.6f,%.3f,%.4f,%.0f,%.2f\n", W.Name, eng, Threads, best.Cycles, best.Insts, best.Sec, ns, mips, cps, over);}
+			if(Format == 2){
+				printf("%s  {\"workload\": \"%s\", \"engine\": \"%s\", \"threads\": %d, \"cycles\": %llu, \"instructions\": %llu, "
+				       "\"seconds\": %.6f, \"ns_per_cycle\": %.3f, \"mips\": %.4f, \"cycles_per_sec\": %.0f, \"loop_overhead\": %.2f}",
+				       first ? "" : ",\n", W.Name, eng, Threads, best.Cycles, best.Insts, best.Sec, ns, mips, cps, over);
+			}
+			first = false;
+		}
+	}
+	if(Format == 2){ printf("\n]\n");}
+
+	return 0;
+}
@@ -0,0 +1,183 @@
+#include <iostream>
+#include <cstring>
+#include <chrono>
+
+#include "mylib/DeviceLibrary.cpp"
+#include "mylib/HostLibrary.cpp"
+#include "mylib/Kit6502.cpp"
+
+// The kit without a window: runs at full speed until a cycle or instruction limit, then prints
+// the CPU state, memory dumps and the emulation speed. No SDL, meant for scripts and CI.
+//
+//   g++ -O2 -o headless headless.cpp -pthread
+//   headless --prog resources/PROG_BINCOUNT --at 0200 --go 0200 --cycles 1000000 --dump 0000:40
+
+using namespace std;
+
+void Usage(){
+	printf("headless [options]\n"
+	       "  --rom PATH        16KB ROM image            (resources/ROM)\n"
+	       "  --pal PATH        64KB address decoder PAL  (resources/PAL)\n"
+	       "  --prog PATH       program loaded into RAM   (none)\n"
+	       "  --at HEX          program load address      (0200)\n"
+	       "  --go HEX          start there instead of the monitor (reset vector)\n"
+	       "  --cycles N        stop after N CPU cycles   (1000000)\n"
+	       "  --insts N         stop after N instructions (instead of cycles)\n"
+	       "  --dump HEX:HEX    print memory, start:length (can be repeated)\n"
+	       "  --save PATH:HEX:HEX  write RAM start:length to a file\n"
+	       "  --profile N       time every device, sampled every N ticks (256)\n"
+	       "  --trace PATH      save the last 1M instructions (tracedecode)\n"
+	       "  --vcd PATH        bus waveforms for GTKWave (CPU, enables, NMI circuit)\n"
+	       "  --calls PATH      cycles per routine, collapsed stacks for flame graphs\n"
+	       "  --syms PATH       routine names for --calls (\"C0A3 SCAN\" lines)\n"
+	       "  --cover PATH      executed addresses and branch directions (csv)\n"
+	       "  --quiet           only the summary line\n");
+}
+
+bool HexRange(const char *s, unsigned int &a, unsigned int &n){     // "start:length"
+	return sscanf(s, "%x:%x", &a, &n) == 2;
+}
+
+void Dump(Kit6502 &Kit, unsigned int Addr, unsigned int Len){
+	for(unsigned int i = 0; i < Len; i += 16){
+		printf("%04x:", (Addr + i) & 0xffff);
+		for(unsigned int j = i; j < i + 16 && j < Len; j++){ printf(" %02x", Kit.Peek((Addr + j) & 0xffff));}
+		printf("\n");
+	}
+}
+
+
+int main(int argc, char *argv[]){
+
+	string RomPath = "resources/ROM", PalPath = "resources/PAL", ProgPath = "";
+	unsigned int ProgAt = 0x200, Go = 0, a, n;
+	bool UseGo = false, Quiet = false;
+	unsigned int ProfEvery = 0;                                     // 0: no device timing
+	unsigned long long MaxCycles = 1000000, MaxInsts = 0;
+	const char *Dumps[16]; int DumpCount = 0;
+	const char *Saves[16]; int SaveCount = 0;
+	const char *TracePath = NULL, *VcdPath = NULL, *CallsPath = NULL, *SymsPath = NULL, *CoverPath = NULL;
+
+	//--------- Command line ---------
+
+	for(int i = 1; i < argc; i++){
+		string o = argv[i];
+		bool more = (i + 1 < argc);
+
+		if(o == "--rom" && more){ RomPath = argv[++i];}
+		else if(o == "--pal" && more){ PalPath = argv[++i];}
+		else if(o == "--prog" && more){ ProgPath = argv[++i];}
+		else if(o == "--at" && more){ ProgAt = strtoul(argv[++i], NULL, 16);}
+		else if(o == "--go" && more){ Go = strtoul(argv[++i], NULL, 16); UseGo = true;}
+		else if(o == "--cycles" && more){ MaxCycles = strtoull(argv[++i], NULL, 10);}
+		else if(o == "--insts" && more){ MaxInsts = strtoull(argv[++i], NULL, 10); MaxCycles = 0;}
+		else if(o == "--dump" && more && DumpCount < 16){ Dumps[DumpCount++] = argv[++i];}
+		else if(o == "--save" && more && SaveCount < 16){ Saves[SaveCount++] = argv[++i];}
+		else if(o == "--profile" && more){ ProfEvery = strtoul(argv[++i], NULL, 10);}
+		else if(o == "--trace" && more){ TracePath = argv[++i];}
+		else if(o == "--vcd" && more){ VcdPath = argv[++i];}
+		else if(o == "--calls" && more){ CallsPath = argv[++i];}
+		else if(o == "--syms" && more){ SymsPath = argv[++i];}
+		else if(o == "--cover" && more){ CoverPath = argv[++i];}
+		else if(o == "--quiet"){ Quiet = true;}
+		else{ Usage(); return 2;}
+	}
+
+	//------------ Machine -----------
+
+	Kit6502 Kit;                                                    // draws into its own memory
+
+	if(!Kit.LoadSystem(RomPath, PalPath)){ printf("can't load %s / %s\n", RomPath.c_str(), PalPath.c_str()); return 1;}
+	if(ProgPath != "" && !Kit.LoadProgram(ProgPath, ProgAt)){ printf("can't load %s\n", ProgPath.c_str()); return 1;}
+	if(UseGo){ Kit.SetResetVector(Go);}
+
+	DeviceProfiler Prof(ProfEvery);
+	if(ProfEvery != 0){ Kit.Profile(&Prof);}
+
+	TraceBuffer *Trace = NULL;                                      // allocated only when asked for
+	if(TracePath != NULL){ Trace = new TraceBuffer(1 << 20); Kit.Cpu.AttachTrace(Trace);}
+
+	CallProfiler Calls;
+	if(SymsPath != NULL && !Calls.LoadSymbols(SymsPath)){ printf("can't load %s\n", SymsPath); return 1;}
+	if(CallsPath != NULL){ Kit.Cpu.AttachCalls(&Calls);}
+
+	Coverage *Cover = NULL;
+	if(CoverPath != NULL){ Cover = new Coverage(); Kit.Cpu.AttachCoverage(Cover);}
+
+	InterruptStats Ints;                                            // only touched by interrupts, always on
+	Kit.Cpu.AttachInterrupts(&Ints);
+
+	BusProbe *Vcd = NULL;
+	if(VcdPath != NULL){
+		Vcd = new BusProbe(&Kit.Clk, VcdPath);
+		Vcd->Add(&Kit.Clk, "clk", 1);        Vcd->Add(&Kit.CpuAddr, "addr", 16);   Vcd->Add(&Kit.CpuData, "data", 8);
+		Vcd->Add(&Kit.CpuIO, "rw", 1);       Vcd->Add(&Kit.CpuSync, "sync", 1);    Vcd->Add(&Kit.Irq, "irq", 1);
+		Vcd->Add(&Kit.Nmi, "nmi", 1);        Vcd->Add(&Kit.ShftData, "shft_q", 1); Vcd->Add(&Kit.ShftClr, "shft_clr", 1);
+		Vcd->Add(&Kit.RamE, "ram_e", 1);     Vcd->Add(&Kit.RomE, "rom_e", 1);      Vcd->Add(&Kit.GpioE, "gpio_e", 1);
+		Vcd->Add(&Kit.Port0E, "port0_e", 1); Vcd->Add(&Kit.Port1E, "port1_e", 1);  Vcd->Add(&Kit.Port2E, "port2_e", 1);
+		Kit.System[Kit.SystemCount++] = Vcd;                        // after the devices: settled values
+	}
+
+	//------------- Run --------------
+
+	std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+
+	unsigned long long step, done;
+	while(!Kit.Watch.Halted()){
+		step = 64;                                                  // limits are checked every 64 cycles
+		done = Kit.Cpu.getCycleCount();
+		if(MaxCycles != 0){ 
+			if(done >= MaxCycles){ break;}
+			if(MaxCycles - done < step){ step = MaxCycles - done;}
+		}
+		if(MaxInsts != 0){                                          // stops at the fetch of instruction N+1
+			if(Kit.Cpu.getInstCount() > MaxInsts){ break;}
+			step = 1;
+		}
+		for(; step != 0; step--){ Kit.Tick(); Kit.Tick();}          // two ticks make a cycle
+	}
+
+	double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+	//------------ Report ------------
+
+	if(!Quiet){
+		PrintCpu(Kit.Cpu);
+		if(Kit.Watch.Halted()){ Kit.Watch.PrintLog();}
+		if(ProfEvery != 0){ Prof.Print();}
+		if(CallsPath != NULL){ Calls.Sync(Kit.Cpu.getCycleCount()); Calls.Print(20);}
+		if(Cover != NULL){ Cover->PrintSummary(0x0000, 0xffff);}
+		if(Ints.Any()){ Ints.Print();}
+
+		for(int i = 0; i < DumpCount; i++){
+			if(HexRange(Dumps[i], a, n)){ Dump(Kit, a, n); printf("\n");}
+		}
+	}
+	if(CallsPath != NULL){
+		Calls.Sync(Kit.Cpu.getCycleCount());
+		if(!Calls.SaveCollapsed(CallsPath)){ printf("can't write %s\n", CallsPath);}
+	}
+	if(Cover != NULL){
+		if(!Cover->SaveCsv(CoverPath)){ printf("can't write %s\n", CoverPath);}
+		delete Cover;
+	}
+	if(Vcd != NULL){
+		Vcd->Close();
+		if(!Quiet){ printf("vcd: %llu changes, %llu waits for the writer\n", Vcd->GetEvents(), Vcd->GetStalls());}
+		delete Vcd;
+	}
+	if(Trace != NULL){
+		if(!Trace->Save(TracePath)){ printf("can't write %s\n", TracePath);}
+		delete Trace;
+	}
+	for(int i = 0; i < SaveCount; i++){
+		char path[512];
+		if(sscanf(Saves[i], "%511[^:]:%x:%x", path, &a, &n) == 3){ MemoryToFile(Kit.Ram, Kit.Ram.GetSize(), a, path, n);}
+	}
+
+	unsigned long long cycles = Kit.Cpu.getCycleCount(), insts = Kit.Cpu.getInstCount();
+	printf("cycles %llu  instructions %llu  time %.3fs  %.0f cycles/s (%.2fx the kit)\n",
+	       cycles, insts, sec, sec > 0 ? cycles / sec : 0.0, sec > 0 ? cycles / sec / 1000000.0 : 0.0);
+
+	return 0;
+}
@@ -9,119 +9,184 @@
 #include "stb/stb_image.h"
 
 #include "mylib/DeviceLibrary.cpp"
+#include "mylib/HostLibrary.cpp"
+#include "mylib/Kit6502.cpp"
 
 #define UCHAR unsigned char
 
 
 using namespace std;
 
-void PrintCpu(CPU_6510 &Z){
+void DefaultKeys(KeyBinding &K){
 	
-	const char Names[][10] = { "A", "X", "Y", "S", "F", "Sync", "PC", "Inst", "cycle", "NmiRqs", "IrqRqs", "RstRqs",
-	                           "-AdBuf-", "-DtBuf-", "-IoBuf-" };
-	const bool bit16[] = {0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 1, 0, 0};
+	// kit key codes:  COPY  C  D  E  F  PC   SBR  INS  RESET      0 -  8
+	//                 REL   8  9  A  B  REG  CBR  DEL  MON        9 - 17
+	//                 SEND  4  5  6  7  DATA -    STEP IRQ       18 - 26
+	//                 LOAD  0  1  2  3  ADDR +    GO   REP       27 - 35
 	
-	printf("\n==== CPU Status ====\n");
+	const int Hex[16] = { 28, 29, 30, 31, 19, 20, 21, 22, 10, 11, 12, 13, 1, 2, 3, 4 };   // 0-F
 	
-	printf("A = %02x   X = %02x   Y = %02x\n", Z.GetCpuReg(0), Z.GetCpuReg(1), Z.GetCpuReg(2));
-	printf("  S = %02x   PC = %04x\n", Z.GetCpuReg(3), Z.GetCpuReg(6));
-	printf("     F = %d%d%d%d%d%d%d%d\n", (Z.GetCpuReg(4)>>7)&0x01, (Z.GetCpuReg(4)>>6)&0x01, (Z.GetCpuReg(4)>>5)&0x01, (Z.GetCpuReg(4)>>4)&0x01,
-                                       	  (Z.GetCpuReg(4)>>3)&0x01, (Z.GetCpuReg(4)>>2)&0x01, (Z.GetCpuReg(4)>>1)&0x01, (Z.GetCpuReg(4))&0x01);
-	
-	printf("====================\n\n\n");
+	for(int i = 0; i < 10; i++){
+		K.Bind(i == 0 ? SDL_SCANCODE_0 : SDL_SCANCODE_1 + i - 1, Hex[i]);
+		K.Bind(i == 0 ? SDL_SCANCODE_KP_0 : SDL_SCANCODE_KP_1 + i - 1, Hex[i]);
+	}
+	for(int i = 0; i < 6; i++){ K.Bind(SDL_SCANCODE_A + i, Hex[10+i]);}
+	
+	K.Bind(SDL_SCANCODE_EQUALS, 33);    K.Bind(SDL_SCANCODE_KP_PLUS, 33);     // +
+	K.Bind(SDL_SCANCODE_MINUS, 24);     K.Bind(SDL_SCANCODE_KP_MINUS, 24);    // -
+	K.Bind(SDL_SCANCODE_RETURN, 34);    K.Bind(SDL_SCANCODE_KP_ENTER, 34);    // GO
+	K.Bind(SDL_SCANCODE_ESCAPE, 8);                                           // RESET
+	K.Bind(SDL_SCANCODE_F1, 32);        K.Bind(SDL_SCANCODE_F2, 23);          // ADDR DATA
+	K.Bind(SDL_SCANCODE_F3, 5);         K.Bind(SDL_SCANCODE_F4, 14);          // PC REG
+	K.Bind(SDL_SCANCODE_F5, 25);        K.Bind(SDL_SCANCODE_F6, 7);           // STEP INS
+	K.Bind(SDL_SCANCODE_F7, 16);        K.Bind(SDL_SCANCODE_F8, 0);           // DEL COPY
+	K.Bind(SDL_SCANCODE_F9, 9);         K.Bind(SDL_SCANCODE_F10, 18);         // REL SEND
+	K.Bind(SDL_SCANCODE_F11, 27);       K.Bind(SDL_SCANCODE_F12, 6);          // LOAD SBR
+	K.Bind(SDL_SCANCODE_INSERT, 7);     K.Bind(SDL_SCANCODE_DELETE, 16);      // INS DEL
+	K.Bind(SDL_SCANCODE_PAGEUP, 15);                                          // CBR
+	K.Bind(SDL_SCANCODE_HOME, 17);      K.Bind(SDL_SCANCODE_END, 35);         // MON REP
+	K.Bind(SDL_SCANCODE_PAUSE, 26);                                           // IRQ
 }
 
 
 int main(){
 	
-	//----------- Variables ----------
-
-
-	StandardBus<uint16_t>  CpuAddr;                                                  // (PRESENTATION NOTE): no argument constructor
-	StandardBus<uint8_t>   CpuData;
-	StandardBus<bool>      CpuIO, CpuSync, Nmi;
-	Clock                  Clk(1,1);                                                 // (PRESENTATION NOTE): two argument constructor
-	
-	StandardBus<bool>      RamE, RomE, GpioE, Port0E, Port1E, Port2E;                // enable lines
-	StandardBus<bool>      ShftData, ShftClr;
-	
-	StandardBus<bool>      LedData[8];                                               // (PRESENTATION NOTE): array of LED lines
-
-	StandardBus<uint8_t>   PalData, GpioData, Port0Data, Port1Data, Port2Data;       // Pal data bus
-	
-	CollectorBitBus        Irq, Null;       // unatached outputs can go here! It's a collector bus, therefore no errors
-	
-	VccSource Vcc;
-	GndSource Gnd;
-	
-	
 	//------------ Connection Setup --------------
 	
-	int MouseX, MouseY, Code;                         // mouse click location and button code
-	
 	int img_width, img_height, img_channels;
 	unsigned char *VBuff = stbi_load("resources/blank2.png", &img_width, &img_height, &img_channels, 4);
 	
-	CpuIO = true;                  // (PRESENTATION NOTE): Assignment (equal sign) overload. Chaining.
-	Null.Reset(); Irq.Reset();
-	
-	// (PRESENTATION NOTE): You can still assign "collector bus" pointers to "Standard Bus" pointers due to inheritance
-	//                      virtual functions will do the job
-	
-	
-	CPU_6510 Cpu(0, &CpuAddr, &CpuData, &CpuSync, &CpuIO, &Gnd, &Clk, &Irq, &Nmi);
-	
-	MemoryDevice<uint16_t, uint8_t> Ram(1, &RamE, 15, &CpuAddr, 8, &CpuData, &CpuIO);         // (PRESENTATION NOTE): using the template classes
-	
-	MemoryDevice<uint16_t, uint8_t> Rom(2, &RomE, 14, &CpuAddr, 8, &CpuData);                 // ROM functionality 
+	Kit6502 Kit(VBuff);                                                           // busses, devices and the memory map (Kit6502.cpp)
+	//Kit.Disp.SetShading(true);                                                  // brightness from the scan duty cycle
+	//Kit.Watch.Add(0x0000, WATCH_WRITE, true);                                   // e.g. stop on a write to $0000
+
+
+	//------ Memory Initialization ------
 	
-	MemoryDevice<uint16_t, uint8_t> Pal(3, &Gnd, 16, &CpuAddr, 8, &PalData);                  // ROM functionality
 	
-	Splitter8 Splt(&PalData, &RomE, &RamE, &GpioE, &Port0E, &Port1E, &Port2E, &Null, &Null);  // collector bus compatibility with standard bus
+	Kit.LoadSystem("resources/ROM", "resources/PAL");                             // ROM, PAL and the map patches
 	
-	LatchReg<uint8_t> Gpio(&CpuData, &GpioData, &GpioE);
+	Kit.LoadProgram("resources/PROG_BINCOUNT", 512);
 	
-	TriGate<uint8_t> Port0(&Port0Data, &CpuData, &Port0E);
+	//Kit.LoadProgram("resources/PROG_SEG7", 512);
+
+	//DeltaDumper< MemoryDevice<uint16_t, uint8_t> > Dump(&Kit.Cpu, Kit.Ram, 0, 32768, "resources/RAM_DELTA", 5000);
+	//Kit.System[Kit.SystemCount++] = &Dump;                                      // RAM changes every 5000 cycles
+
+	//HeatProfiler *Heat = new HeatProfiler(&Kit.Clk, &Kit.CpuSync);              // per-address access counters
+	//Kit.Ram.AttachProbe(Heat); Kit.Rom.AttachProbe(Heat);                       // (save them after the main loop)
+	
+	//DeviceProfiler Prof(256); Kit.Profile(&Prof);                               // host time per device, printed
+	                                                                              // every 5s by the emulation thread
+	//TraceBuffer Trace(1 << 20); Kit.Cpu.AttachTrace(&Trace);                    // last 1M instructions (saved at the end)
+	//CallProfiler Calls; Calls.LoadSymbols("resources/SYMBOLS"); Kit.Cpu.AttachCalls(&Calls);   // cycles per routine
+	//Coverage *Cover = new Coverage(); Kit.Cpu.AttachCoverage(Cover);           // executed code, branch directions
+	//InterruptStats Ints; Kit.Cpu.AttachInterrupts(&Ints);                      // IRQ/NMI latency and handler cycles
+	
+	//BusProbe Vcd(&Kit.Clk, "resources/BUS.vcd");                                // bus waveforms for GTKWave
+	//Vcd.Add(&Kit.CpuAddr, "addr", 16); Vcd.Add(&Kit.CpuData, "data", 8); Vcd.Add(&Kit.Nmi, "nmi", 1);
+	//Kit.System[Kit.SystemCount++] = &Vcd;                                       // last: it samples the settled busses
+
 	
-	LatchReg<uint8_t> Port1(&CpuData, &Port1Data, &Port1E);
+	//---------- Emulation thread -----------
 	
-	LatchReg<uint8_t> Port2(&CpuData, &Port2Data, &Port2E);
+	// The machine runs on its own thread in slices of about 10ms, every slice ends with a finished
+	// frame handed to the render thread. Nothing here waits for the display.
 	
-	Keyboard_6502kit Key(&Port1Data, &Port0Data, 18, 91, &MouseX, &MouseY, &Code);
+	Pacer Pace(1000000.0);                               // the kit runs at 1MHz (2 ticks per cycle)
+	//Pace.SetSpeed(4.0);                                // 4x real time, 0 = as fast as possible
 	
-	Segment8D Disp(&Port2Data, &Port1Data, &Port2E, VBuff, 2208, 0, 0);
+	ThroughputMeter Meter(1000000.0);                    // window title numbers
+	Meter.SetTarget(Pace.GetSpeed());
 	
-	ShftReg8<bool> Shft(&Vcc, &ShftData, &CpuSync, &ShftClr);
+	TripleBuffer Frames(552, 300, 2208);
+	InputQueue Input;                                    // mouse and key events from the SDL thread
+	std::atomic<bool> Quit(false);
 	
-	NotGate Not(&ShftData, &Nmi);
+	unsigned long long MinHold = 100000;                 // shortest key press in ticks (50ms), the ROM has to see it
 	
-	Splitter8to1 Splt2(&Port1Data, &ShftClr, 6);
+	KeyBinding Keys;                                     // host keyboard to kit keys
+	DefaultKeys(Keys);
+	Keys.Load("resources/KEYMAP");                       // optional "scancode code" lines
 	
-	Splitter8 LedSplt( &GpioData,   &LedData[0], &LedData[1], &LedData[2], &LedData[3], 
-					   &LedData[4], &LedData[5], &LedData[6], &LedData[7]);
+	Kit.Dirty.Mark(0, 0, 552, 300);                          // first frame is uploaded complete
 	
-	SquareLed *LedP[8];                                                           // array of pointers to LED objects
-	for(int j = 315, i = 0; i < 8; i++, j+=19){
-		if(i == 4){ j += 16;}
-		LedP[i] = new SquareLed(&LedData[i], VBuff, 2208, j, 34);                 // (PRESENTATION NOTE): Initializing dynamically allocated objects!!!
-	}
+	std::thread Emulation([&](){
+		
+		int k;
+		unsigned long long ix, Slice, Stop, Start, At;
+		std::chrono::steady_clock::time_point Busy;
+		unsigned long long PressAt[37], ReleaseAt[37];      // kit keys 0-35, 36 = mouse (ReleaseAt 0: none due)
+		const InputEvent *ev;
+		
+		for(k = 0; k < 37; k++){ PressAt[k] = 0; ReleaseAt[k] = 0;}
+		
+		Pace.Rebase();
+		while(!Quit){
 			
+			Busy = std::chrono::steady_clock::now();
+			Slice = Pace.Budget();                           // ticks due since the last slice
+			Start = Pace.GetTicks();
+			
+			//---- begin evaluation ----
+			
+			for(ix = 0; ix < Slice && !Kit.Watch.Halted(); ){
+				
+				Stop = Slice;                                // run up to the next input event
+				while((ev = Input.Peek()) != NULL){
+					At = Pace.TickAt(ev->When);
+					if(At > Start + ix){ 
+						if(At - Start < Stop){ Stop = At - Start;}
+						break;
+					}
+					
+					k = (ev->Type == INPUT_PRESS || ev->Type == INPUT_RELEASE) ? 36 : ev->X;
+					if(ev->Type == INPUT_PRESS || ev->Type == INPUT_KEYDOWN){
+						if(k == 36){ Kit.MouseX = ev->X; Kit.MouseY = ev->Y;}
+						else{ Kit.Key.Press(k, true);}
+						PressAt[k] = Start + ix; ReleaseAt[k] = 0;
+					}
+					else{                                    // releases wait for the minimum hold time
+						ReleaseAt[k] = (PressAt[k] + MinHold > Start + ix) ? PressAt[k] + MinHold : Start + ix;
+					}
+					Input.Pop();
+				}
+				
+				for(k = 0; k < 37; k++){                     // due releases, RESET acts on release
+					if(ReleaseAt[k] == 0){ continue;}
+					if(ReleaseAt[k] > Start + ix){ 
+						if(ReleaseAt[k] - Start < Stop){ Stop = ReleaseAt[k] - Start;}
+						continue;
+					}
+					if(k == 36){ 
+						if(Kit.Code == 8){ Kit.Cpu.ResetRequest();}
+						Kit.MouseX = 0; Kit.MouseY = 0;
+					}
+					else{
+						if(k == 8){ Kit.Cpu.ResetRequest();}
+						Kit.Key.Press(k, false);
+					}
+					ReleaseAt[k] = 0;
+				}
+				
+				for(; ix < Stop && !Kit.Watch.Halted(); ix++){ Kit.Tick();}
+			}
+			Pace.Ran(ix);
+			
+			if(Kit.Watch.Halted()){ Kit.Watch.PrintLog(); Quit = true;} // a watchpoint stopped the run
+			//if(Prof.Due(5.0)){ Prof.Print(); Prof.Clear();}           // device time report
+			
+			Kit.Frame();                                         // digits that are still lit, LEDs
+			
+			//---- end evaluation ----
+			
+			if(!Kit.Dirty.Empty()){ Frames.Publish(VBuff, Kit.Dirty);}  // never blocks
+			
+			Meter.Slice(Pace.GetTicks(), Kit.Cpu.getInstCount(), std::chrono::steady_clock::now() - Busy);
+			Pace.Wait();
+		}
+	});
 	
-	Device *System[14] = { &Cpu, &Pal, &Splt, &Rom, &Ram, &Port1, &Key, &Port0,    // (PRESENTATION NOTE): Emulation pointer list
-					       &Port2, &Disp, &Gpio, &Splt2, &Shft, &Not };
-	
-
-	//------ Memory Initialization ------
-	
-	
-	FileToMemory(Rom, Rom[0], 16384, 0, "resources/ROM", 0, 16384);               // (PRESENTATION NOTE): using a template function
-	
-	FileToMemory(Pal, Pal[0], 65536, 0, "resources/PAL", 0, 65536);
-	
-	FileToMemory(Ram, Ram[0], 65536, 512, "resources/PROG_BINCOUNT", 0, 16);
-	
-	//FileToMemory(Ram, Ram[0], 65536, 512, "resources/PROG_SEG7", 0, 176);
-
 	
 	//---------- SDL setup -----------
 	
@@ -129,86 +194,71 @@ int main(){
 	SDL_Window* gWindow = NULL;
 	SDL_Renderer* gRenderer = NULL;
 	SDL_Texture* mTexture;
-	SDL_Event e; bool quit, first;
+	SDL_Event e; bool show, shown = false;
+	char Title[128];
 	
 	initSDL(&gWindow, 590, 335, &mTexture, 552, 300, &gRenderer, 1.0);
 	
 	clearwinSDL( &gRenderer, 0x0a392fff );            // Clear screen
 	
-	unsigned int iy, ix = 0;
-	
-	first = true;
-	quit = false;	                                             // Main loop flag
-	while(!quit){                                                // While application is running
+	while(!Quit){                                                // While application is running
 	
+		show = false;
 		while(SDL_PollEvent(&e) != 0){                           // Handle events on queue
-			if( e.type == SDL_QUIT ){ quit = true;}              // If user requests quit
-			if( e.type == SDL_MOUSEBUTTONDOWN )
-			{
-				MouseX = e.motion.x;                             // Get the mouse offsets
-				MouseY = e.motion.y;
-			}
-			if( e.type == SDL_MOUSEBUTTONUP ){
-				MouseX = 0;
-				MouseY = 0;
-				if(Code == 8){ Cpu.ResetRequest();}
-			}
-		}
-		
-		//---- begin evaluation ----
-		
-		for(ix = 0; ix < 200000; ix++){
+			if( e.type == SDL_QUIT ){ Quit = true;}              // If user requests quit
+			if( e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_EXPOSED ){ show = shown;}
 			
-			/*
-			Cpu.Evaluate();	
-			Pal.Evaluate();
-			Splt.Evaluate();
-			Rom.Evaluate();
-			Ram.Evaluate();
-			Port1.Evaluate();
-			Key.Evaluate();
-			Port0.Evaluate();
-			Port2.Evaluate();
-			Disp.Evaluate();
-			Gpio.Evaluate();
-			Splt2.Evaluate();
-			Shft.Evaluate();
-			Not.Evaluate();
-			*/
+			// when it happened: SDL time stamps are milliseconds of SDL_GetTicks()
+			std::chrono::steady_clock::time_point When = std::chrono::steady_clock::now() 
+			                                             - std::chrono::milliseconds(SDL_GetTicks() - e.common.timestamp);
 			
-			for(iy = 0; iy < 14; iy++){ System[iy]->Evaluate();} 
-				
-			Clk++;
+			if( e.type == SDL_MOUSEBUTTONDOWN ){ Input.Push(INPUT_PRESS, e.button.x, e.button.y, When);}    // mouse offsets
+			if( e.type == SDL_MOUSEBUTTONUP ){ Input.Push(INPUT_RELEASE, 0, 0, When);}
+			
+			if( (e.type == SDL_KEYDOWN || e.type == SDL_KEYUP) && e.key.repeat == 0 ){       // host keyboard
+				int kit = Keys.Get(e.key.keysym.scancode);
+				if(kit >= 0){ Input.Push(e.type == SDL_KEYDOWN ? INPUT_KEYDOWN : INPUT_KEYUP, kit, 0, When);}
+			}
 		}
 		
-		LedSplt.Evaluate();
-		for(iy = 0; iy < 8; iy++){ LedP[iy]->Evaluate();}        // LED object evaluation
-		
-		//---- end evaluation ----
-		
-		
-		void* vi = getptrSDL( &mTexture );                       // Lock texture and get data pointer
-			
-		if(first){ 
-			memcpy( vi, VBuff, 662400);                          // full frame copy
-			first = false;
+		Meter.RenderBegin();
+		if(Frames.Acquire()){                                    // newest complete frame, changed rectangles only
+			const DirtyTracker &d = Frames.GetFrontDirty();
+			for(int n = 0; n < d.GetCount(); n++){
+				const ScreenRect &r = d.Get(n);
+				updateSDL( &mTexture, r.x, r.y, r.w, r.h, Frames.GetFront() + r.y*2208 + r.x*4, 2208 );
+			}
+			show = shown = true;
 		}
-		else{ 
-			memcpy( vi, VBuff, 132480);                          // the display section copy
+		else if(show){                                           // window damaged, the texture is still complete
+			updateSDL( &mTexture, 0, 0, 552, 300, Frames.GetFront(), 2208 );
 		}
 		
-		renderSDL( &mTexture, 18, 17, 552, 300, &gRenderer );    // unlock and render
+		Meter.RenderEnd(show);                                   // uploads only, not the vsync wait
 		
-		limitfpsSDL(10);                                         // fps limit, returns limit successful flag
-			
+		if(show){ presentSDL( &mTexture, 18, 17, 552, 300, &gRenderer );}   // waits for vsync
+		else{ SDL_Delay(1);}                                     // nothing new yet
+		
+		if(Meter.Update(0.25, Title, 128)){ titleSDL( &gWindow, Title );}   // 4 times a second
 	}
-
+	
+	Emulation.join();
+	
 	closeSDL(&gWindow, &mTexture, &gRenderer);
 	stbi_image_free(VBuff);
 	
-	PrintCpu(Cpu);
+	PrintCpu(Kit.Cpu);
+	printf("Speed: %.1f%% of the real kit\n", Pace.GetRatio()*100.0);
 	
-	//MemoryToFile(M, 0x10000, 0x0200, "resources/OUT", 256);
+	//MemoryToFile(Kit.Ram, 0x8000, 0x0200, "resources/OUT", 256);
+	
+	//Trace.Save("resources/TRACE");                                             // tracedecode resources/TRACE
+	//Vcd.Close();
+	//Calls.Sync(Kit.Cpu.getCycleCount()); Calls.Print(20); Calls.SaveCollapsed("resources/CALLS.txt");
+	//Cover->PrintSummary(0x0200, 0x7fff); Cover->SaveCsv("resources/COVER.csv");
+	//Ints.Print();
+
+	//Heat->PrintPages(16); Heat->SaveCsv("resources/HEAT.csv"); Heat->SaveImage("resources/HEAT.ppm");
 	
 	//-------------- End --------------
 	
@@ -0,0 +1,290 @@
+#include <iostream>
+#include <cstring>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#include "mylib/DeviceLibrary.cpp"
+#include "mylib/Disasm_6502.cpp"
+
+// Per opcode cost of CPU_6510: every documented opcode runs in every addressing mode against a
+// flat 64KB RAM (no PAL, no ports, two devices per tick) and the list is ranked by host time per
+// emulated cycle, the most expensive handlers first.
+//
+//   g++ -O2 -o microbench microbench.cpp
+//   microbench [--cycles N] [--reps N] [--op HEX] [--top N] [--csv]
+//
+// Each variant repeats one instruction 256 times, followed by a JMP back. The JMP is measured on
+// its own first and taken out of every result. Indexed reads run without and with a page
+// crossing (+page), branches not taken, taken and taken to the next page. RTS and RTI can't run
+// on their own: they are measured together with JSR and BRK. The cycle column is what the
+// emulator took, a '!' marks a count that differs from the data sheet. Opcodes the CPU runs as
+// NOP (no handler yet) are listed as not implemented and left out of the ranking.
+
+using namespace std;
+
+//======================================== Flat Machine ===================================
+
+class FlatMachine {
+	public:
+		StandardBus<uint16_t> Addr;
+		StandardBus<uint8_t>  Data;
+		StandardBus<bool>     IO, Sync, Nmi;
+		CollectorBitBus       Irq;
+		GndSource             Gnd;
+		Clock                 Clk;
+
+		CPU_6510 Cpu;
+		MemoryDevice<uint16_t, uint8_t> Mem;        // always enabled, RAM everywhere
+
+		FlatMachine() :
+			Clk(1,1),
+			Cpu(0, &Addr, &Data, &Sync, &IO, &Gnd, &Clk, &Irq, &Nmi),
+			Mem(1, &Gnd, 16, &Addr, 8, &Data, &IO)
+		{
+			IO = true; Irq.Reset();
+			for(int i = 0; i < 65536; i++){ Mem[i] = 0;}
+		}
+
+		void Cycle(){                                // two ticks
+			for(int i = 0; i < 2; i++){
+				Irq.Reset();
+				Cpu.Evaluate();
+				Mem.Evaluate();
+				Clk++;
+			}
+		}
+};
+
+//======================================== Variants =======================================
+
+#define V_PLAIN     0
+#define V_PAGE      1                // indexed address crosses a page
+#define V_NOTTAKEN  2
+#define V_TAKEN     3
+#define V_TAKENPAGE 4
+
+const char *VariantName[] = { "", "+page", "not taken", "taken", "taken+page" };
+
+#define BODY    0x0400               // first instance, the preamble is at $0200
+#define REPEAT  256
+#define DATA    0x3000               // operand area, zero filled
+#define PTRTAB  0x3200               // JMP ($nnnn) pointers
+#define BRKVEC  0x3800               // RTI
+#define SUB     0x3900               // RTS
+
+struct Variant {
+	uint8_t Op;
+	int Kind;                        // V_...
+	int Org, Repeat;                 // where the instances start and how many
+	int Insts;                       // instructions per instance (2 for JSR+RTS, BRK+RTI)
+	int Expect;                      // data sheet cycles per instance
+	char Text[32];                   // first instance, disassembled
+};
+
+struct Result {
+	Variant V;
+	double Ns;                       // per instance, without the JMP back
+	double Cycles;                   // emulated cycles per instance
+};
+
+// Flags for the branch to be taken or not: LDA #, CLC/SEC, CLV or BIT $3100 with $40 (V set).
+int BranchFlags(uint8_t op, bool taken, uint8_t *p){
+	bool set = ((op & 0x20) != 0) == taken;     // BMI, BVS, BCS, BEQ branch on a set flag
+	switch(op >> 6){
+		case 0: p[0] = 0xa9; p[1] = set ? 0x80 : 0x01; return 2;                   // N
+		case 1:
+			if(!set){ p[0] = 0xb8; return 1;}                                        // V
+			p[0] = 0xa9; p[1] = 0x40; p[2] = 0x8d; p[3] = 0x00; p[4] = 0x31;
+			p[5] = 0x2c; p[6] = 0x00; p[7] = 0x31; return 8;
+		case 2: p[0] = set ? 0x38 : 0x18; return 1;                                  // C
+		default: p[0] = 0xa9; p[1] = set ? 0x00 : 0x01; return 2;                   // Z
+	}
+}
+
+// Writes the preamble, the instances and the JMP back. Every instance is the same except the
+// JMPs, which chain to the next instance.
+void Setup(FlatMachine &M, Variant &V){
+	uint8_t op = V.Op;
+	const OpInfo &o = OpTable[op];
+	int page = (V.Kind == V_PAGE);
+	uint8_t body[4];
+	int len = OpBytes(op);
+
+	V.Org = BODY; V.Repeat = REPEAT; V.Insts = 1; V.Expect = o.Cycles;
+	if((o.Flags & OP_PAGE) && page){ V.Expect++;}
+	if(V.Kind == V_TAKEN){ V.Expect++;}
+	if(V.Kind == V_TAKENPAGE){ V.Expect += 2;}
+
+	//------- operands -------
+
+	body[0] = op; body[1] = 0; body[2] = 0; body[3] = 0xea;
+	switch(o.Mode){
+		case AM_IMM: body[1] = 0x01; break;
+		case AM_ZP: case AM_ZPX: case AM_ZPY: body[1] = 0x80; break;
+		case AM_ABS: body[1] = DATA & 0xff; body[2] = DATA >> 8; break;
+		case AM_ABX: case AM_ABY: body[1] = page ? 0xf8 : 0x00; body[2] = DATA >> 8; break;   // index $10
+		case AM_IZX: body[1] = 0x80; break;                                                   // X = 0
+		case AM_IZY: body[1] = page ? 0xa0 : 0x90; break;                                     // Y = $10
+		case AM_REL: body[1] = (V.Kind == V_TAKENPAGE) ? 0x01 : 0x00; break;                  // to the next instance
+	}
+	if(op == 0x20){ body[1] = SUB & 0xff; body[2] = SUB >> 8; V.Insts = 2; V.Expect += OpTable[0x60].Cycles;}
+	if(op == 0x00){ len = 2; V.Insts = 2; V.Expect += OpTable[0x40].Cycles;}                // BRK skips a byte
+	if(V.Kind == V_TAKENPAGE){ V.Org = 0x04fd; V.Repeat = 1; len = 3;}                    // $04fd -> $0500
+
+	//------- memory ---------
+
+	M.Mem[0x80] = DATA & 0xff; M.Mem[0x81] = DATA >> 8;            // ($80,X)
+	M.Mem[0x90] = DATA & 0xff; M.Mem[0x91] = DATA >> 8;            // ($90),Y
+	M.Mem[0xa0] = 0xf8;        M.Mem[0xa1] = DATA >> 8;            // ($a0),Y crosses
+	M.Mem[SUB] = 0x60;
+	M.Mem[BRKVEC] = 0x40;
+	M.Mem[0xfffe] = BRKVEC & 0xff; M.Mem[0xffff] = BRKVEC >> 8;
+	M.Mem[0xfffc] = 0x00;          M.Mem[0xfffd] = 0x02;           // reset to the preamble
+
+	int a = 0x200;
+	uint8_t pre[8];
+	M.Mem[a++] = 0xa2; M.Mem[a++] = (o.Mode == AM_IZX || o.Mode == AM_ZPX) ? 0x00 : 0x10;   // LDX
+	M.Mem[a++] = 0xa0; M.Mem[a++] = (o.Mode == AM_ZPY) ? 0x00 : 0x10;                       // LDY
+	if(o.Mode == AM_REL){
+		int n = BranchFlags(op, V.Kind != V_NOTTAKEN, pre);
+		for(int i = 0; i < n; i++){ M.Mem[a++] = pre[i];}
+	}
+	M.Mem[a++] = 0x4c; M.Mem[a++] = V.Org & 0xff; M.Mem[a++] = V.Org >> 8;
+
+	a = V.Org;
+	for(int n = 0; n < V.Repeat; n++){
+		int next = a + len;
+		if(op == 0x4c){ body[1] = next & 0xff; body[2] = next >> 8;}
+		if(op == 0x6c){
+			int p = PTRTAB + n*2;
+			M.Mem[p] = next & 0xff; M.Mem[p+1] = next >> 8;
+			body[1] = p & 0xff; body[2] = p >> 8;
+		}
+		if(n == 0){ Disasm6502(a, body, V.Text);}
+		for(int i = 0; i < len; i++){ M.Mem[a++] = body[i];}
+	}
+	M.Mem[a++] = 0x4c; M.Mem[a++] = V.Org & 0xff; M.Mem[a++] = V.Org >> 8;
+
+	if(op == 0x20){ strcat(V.Text, " +RTS");}
+	if(op == 0x00){ strcat(V.Text, " +RTI");}
+}
+
+//======================================== Measuring ======================================
+
+// Best of reps: host time and cycles per instance with the JMP back taken out (jmp: ns per
+// cycle of the JMP, 0 while measuring the JMP itself).
+Result Measure(Variant V, unsigned long long cycles, int reps, double jmp){
+	Result R; R.Ns = -1; R.Cycles = 0;
+
+	for(int r = 0; r < reps; r++){
+		FlatMachine M;
+		Setup(M, V);
+		for(int c = 0; c < 1000; c++){ M.Cycle();}                 // reset and preamble
+
+		unsigned long long i0 = M.Cpu.getInstCount(), c0 = M.Cpu.getCycleCount();
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+		for(unsigned long long c = 0; c < cycles; c++){ M.Cycle();}
+		double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+
+		double insts = double(M.Cpu.getInstCount() - i0);
+		double loops = insts / (V.Repeat*V.Insts + 1);              // one JMP back per loop
+		double n = loops * V.Repeat;                                // instances run
+		double cyc = double(M.Cpu.getCycleCount() - c0) - loops*3;
+		ns -= loops*3*jmp;
+
+		if(n > 0 && (R.Ns < 0 || ns/n < R.Ns)){ R.Ns = ns/n; R.Cycles = cyc/n;}
+	}
+	R.V = V;
+	return R;
+}
+
+bool Slower(const Result &a, const Result &b){
+	return a.Ns/a.Cycles > b.Ns/b.Cycles;
+}
+
+
+int main(int argc, char *argv[]){
+
+	unsigned long long Cycles = 200000;
+	int Reps = 5, Top = 0, Only = -1;
+	bool Csv = false;
+
+	for(int i = 1; i < argc; i++){
+		string o = argv[i];
+		bool more = (i + 1 < argc);
+
+		if(o == "--cycles" && more){ Cycles = strtoull(argv[++i], NULL, 10);}
+		else if(o == "--reps" && more){ Reps = atoi(argv[++i]);}
+		else if(o == "--op" && more){ Only = strtol(argv[++i], NULL, 16) & 0xff;}
+		else if(o == "--top" && more){ Top = atoi(argv[++i]);}
+		else if(o == "--csv"){ Csv = true;}
+		else{
+			printf("microbench [--cycles N] [--reps N] [--op HEX] [--top N] [--csv]\n");
+			return 2;
+		}
+	}
+	if(Reps < 1){ Reps = 1;}
+
+	//------- variants -------
+
+	vector<Variant> List;
+	vector<uint8_t> Missing;                                         // no handler, runs its operands as opcodes
+	Variant V;
+	FlatMachine Probe;
+	for(int op = 0; op < 256; op++){
+		if(!OpDocumented(op) || op == 0x60 || op == 0x40){ continue;}     // RTS, RTI: with JSR, BRK
+		if(Only >= 0 && op != Only){ continue;}
+		if(!Probe.Cpu.isImplemented(op)){ Missing.push_back(op); continue;}
+
+		V.Op = op; V.Kind = V_PLAIN;
+		int m = OpTable[op].Mode;
+		if(m == AM_REL){
+			V.Kind = V_NOTTAKEN;  List.push_back(V);
+			V.Kind = V_TAKEN;     List.push_back(V);
+			V.Kind = V_TAKENPAGE; List.push_back(V);
+			continue;
+		}
+		List.push_back(V);
+		if(m == AM_ABX || m == AM_ABY || m == AM_IZY){ V.Kind = V_PAGE; List.push_back(V);}
+	}
+
+	//------- measuring ------
+
+	V.Op = 0x4c; V.Kind = V_PLAIN;
+	Result Jmp = Measure(V, Cycles, Reps, 0);
+	double JmpNs = Jmp.Ns / Jmp.Cycles;
+
+	vector<Result> Res;
+	for(size_t i = 0; i < List.size(); i++){ Res.push_back(Measure(List[i], Cycles, Reps, JmpNs));}
+	stable_sort(Res.begin(), Res.end(), Slower);
+
+	//------- report ---------
+
+	if(Csv){ printf("rank,opcode,instruction,variant,cycles,expected,ns_per_cycle,ns_per_instance\n");}
+	else{
+		printf("JMP back: %.2f ns/cycle, %d variants\n\n", JmpNs, int(Res.size()));
+		printf("%4s  %-2s  %-20s %-11s %8s %10s %9s\n", "rank", "op", "instruction", "variant", "cycles", "ns/cycle", "ns/inst");
+	}
+
+	for(size_t i = 0; i < Res.size(); i++){
+		if(Top > 0 && int(i) >= Top){ break;}
+		const Result &r = Res[i];
+		double nc = r.Ns / r.Cycles;
+		bool odd = (r.Cycles < r.V.Expect - 0.01 || r.Cycles > r.V.Expect + 0.01);
+
+		if(Csv){ printf("%d,%02x,%s,%s,%.2f,%d,%.3f,%.3f\n", int(i+1), r.V.Op, r.V.Text, VariantName[r.V.Kind], r.Cycles, r.V.Expect, nc, r.Ns);}
+		else{ printf("%4d  %02x  %-20s %-11s %6.2f%c %10.2f %9.2f\n", int(i+1), r.V.Op, r.V.Text, VariantName[r.V.Kind], r.Cycles, odd ? '!' : ' ', nc, r.Ns);}
+	}
+
+	if(!Csv && !Missing.empty()){ printf("\n");}
+	for(size_t i = 0; i < Missing.size(); i++){
+		uint8_t b[3] = { Missing[i], DATA & 0xff, DATA >> 8 };
+		char text[32];
+		Disasm6502(BODY, b, text);
+		if(Csv){ printf(",%02x,%s,not implemented,,%d,,\n", b[0], text, OpTable[b[0]].Cycles);}
+		else{ printf("%4s  %02x  %-20s not implemented\n", "-", b[0], text);}
+	}
+
+	return 0;
+}
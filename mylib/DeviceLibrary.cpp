@@ -1,6 +1,13 @@
 #include <iostream>
 #include <fstream>
 #include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <chrono>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
 #include <stdlib.h>
 
 using namespace std;
@@ -20,7 +27,7 @@ class StandardBus {
 	public:
 		StandardBus(){                            // no argument constructor
 			mask = 0; mask = mask - 1;
-			value = 0;
+			WriteCount = 0; value = 0;
 		}
 		
 		explicit StandardBus(int bits){           // The explicit keyword prohibits initialization like "StdBus Z = 1;"
@@ -127,25 +134,28 @@ class Clock : public StandardBus<bool>{
 	private:
 		unsigned long devision;
 		unsigned long count;
+		unsigned long long ticks;                    // emulation ticks since power up (time stamps)
 		
 	public:
 		Clock() : StandardBus<bool>() {         // zero argument constructor
 			devision = 1;
-			count = 0;
+			count = 0; ticks = 0;
 		}
 		
 		Clock(bool init, unsigned long dev) : StandardBus<bool>(){            // one argument constructor
 			value = init;
 			devision = dev;                                                   // once can never change clock properties after it
-			count = 0;                                                        // has been initialized	
+			count = 0; ticks = 0;                                             // has been initialized	
 		}
 		
+		unsigned long long GetTicks() const{ return ticks;}
+		
 		void Write(bool data){ WriteCount = 10;}     // can't do anything
 			
 		void Reset(){}                               // reset is prohibited
 		
 		void operator ++ (int){                      // (PRESENTATION NOTE) the only way to update the clock
-			count++;
+			count++; ticks++;
 			if(count == devision){                   // clock incrementation
 				value = !value;
 				count = 0;
@@ -168,6 +178,8 @@ class Device {                          // abstract class (pure virtual function
 			ID = i;
 		}
 		
+		virtual ~Device(){}             // devices are deleted through Device pointers (Kit6502 LEDs)
+		
 		int GetID(){                    // ID cannot be modefied after the object has been created
 			return ID;
 		}
@@ -501,6 +513,23 @@ class Splitter8to1 : public Device {
 
 
 
+//======================================== Memory Probes ==================================
+
+// A probe is attached to the memory path of a MemoryDevice (watchpoints, profilers). Accesses are
+// only handed to the probe if the 256 byte page they fall in has a trap bit set. All the other
+// pages run at full speed (one table lookup, or nothing at all if no probe is attached).
+
+class MemoryProbe {
+	public:
+		uint8_t PageTrap[256];                          // CPU address space pages (0 = not trapped)
+		
+		MemoryProbe(){ memset(PageTrap, 0, 256);}
+		
+		virtual void Access(uint16_t addr, uint8_t data, bool write) = 0;   // address and data as seen on the bus
+};
+
+
+
 //======================================== Memory Device Template =========================
 
 //--- Standard Rom/Ram device template ---
@@ -518,6 +547,16 @@ class MemoryDevice : public Device {
 		AddressCarrier maskA;
 		unsigned int size;
 		
+		MemoryProbe* Probe[4];                      // attached probes
+		int ProbeCount;
+		
+		void NotifyProbes(bool write){
+			uint16_t addr = *AP;                        // probes work with the bus address, not the chip address
+			for(int i = 0; i < ProbeCount; i++){
+				if(Probe[i]->PageTrap[addr >> 8] != 0){ Probe[i]->Access(addr, *DP, write);}
+			}
+		}
+		
 	// (PRESENTATION NOTE):  Initialization list of the constructor to set the initial value -------v
 		
 	public:
@@ -540,6 +579,8 @@ class MemoryDevice : public Device {
 			
 			maskA = 1;
 			maskA = (maskA << address_width) - 1;        // address mask calculation
+			
+			ProbeCount = 0;
 		}
 		
 		~MemoryDevice(){                                 // (PRESENTATION NOTE) destructor
@@ -554,22 +595,475 @@ class MemoryDevice : public Device {
 			return size;
 		}
 		
+		bool AttachProbe(MemoryProbe *p){                // up to 4 probes per device
+			if(ProbeCount == 4){ return false;}
+			Probe[ProbeCount++] = p;
+			return true;
+		}
+		
 		void Evaluate(){                                       // overloading the virtual function!
 			if(*EP == 0){                                      // if the chip is enabled
 				AddressCarrier addr = *AP & maskA;
-				if(IOP != NULL && *IOP == 0){                  // writing to memory (RAM functionality)
+				bool write = (IOP != NULL && *IOP == 0);
+				if(write){                                     // writing to memory (RAM functionality)
 					*(MemP + addr) = *DP & maskD;
 				}
 				else{ 
 					DataCarrier data = *(MemP + addr);         // reading memory (ROM and RAM functionality)
 				    *DP = data & maskD;
-				}                        
+				}
+				if(ProbeCount != 0){ NotifyProbes(write);}
 			}
 		}	
 };
 
 
 
+//======================================== Instruction Trace ==============================
+
+// The last N instructions of the CPU as fixed size binary records ("Cpu.AttachTrace(&Trace);").
+// The ring is allocated once, writing a record is a few stores, nothing locks or allocates,
+// so the trace can stay on and be saved when a kit program goes wrong. Read it on the CPU's
+// thread (or after it stopped), tracedecode.cpp disassembles a saved file.
+
+#define TRACE_NMI    1              // Kind: low two bits, what started (0 = instruction)
+#define TRACE_IRQ    2
+#define TRACE_RESET  3
+#define TRACE_EA     4              // EA holds a data access
+#define TRACE_WRITE  8              // and it was a write
+
+struct TraceRecord {                // 20 bytes, little endian in the file
+	uint32_t Cycle;                 // CycleCount at the opcode fetch (low 32 bits)
+	uint16_t PC, EA;                // EA: last bus access outside of the instruction bytes
+	uint8_t Op, Arg1, Arg2, Kind;   // Arg: the bytes after the opcode (as far as they were read)
+	uint8_t A, X, Y, S, P;          // registers before the instruction
+	uint8_t Pad[3];
+};
+
+class TraceBuffer {
+	private:
+		TraceRecord *Ring, Spare;           // Spare takes the accesses before the first fetch
+		TraceRecord *Cur;
+		unsigned long long Count;           // records written since Clear()
+		unsigned int Mask;
+		
+	public:
+		TraceBuffer(unsigned int size = 1 << 20){                   // rounded up to a power of two
+			unsigned int n = 1;
+			while(n < size){ n <<= 1;}
+			Ring = new TraceRecord [n](); Mask = n - 1;
+			Clear();
+		}
+		
+		~TraceBuffer(){ delete[] Ring;}
+		
+		void Clear(){ Count = 0; Cur = &Spare;}
+		
+		//---- CPU side ----
+		
+		void Begin(unsigned long long cycle, uint16_t pc, uint8_t op, uint8_t kind, 
+		           uint8_t a, uint8_t x, uint8_t y, uint8_t s, uint8_t p){
+			Cur = &Ring[Count & Mask]; Count++;
+			Cur->Cycle = uint32_t(cycle); Cur->PC = pc; Cur->EA = pc;
+			Cur->Op = op; Cur->Arg1 = 0; Cur->Arg2 = 0; Cur->Kind = kind;
+			Cur->A = a; Cur->X = x; Cur->Y = y; Cur->S = s; Cur->P = p;
+		}
+		
+		void Read(uint16_t addr, uint8_t data){
+			uint16_t d = addr - Cur->PC;
+			if(d == 0){ return;}
+			if(d == 1){ Cur->Arg1 = data; return;}
+			if(d == 2){ Cur->Arg2 = data; return;}
+			if(Cur->EA != addr || (Cur->Kind & TRACE_EA) == 0){      // a write stays a write when it's read back
+				Cur->EA = addr; Cur->Kind = (Cur->Kind & 3) | TRACE_EA;
+			}
+		}
+		
+		void Write(uint16_t addr){ Cur->EA = addr; Cur->Kind |= TRACE_EA | TRACE_WRITE;}
+		
+		//---- reading ----
+		
+		unsigned long long GetCount() const{ return Count;}
+		unsigned int GetSize() const{ return Mask + 1;}
+		unsigned int GetKept() const{ return Count > Mask ? Mask + 1 : (unsigned int)Count;}
+		
+		const TraceRecord& Get(unsigned int i) const{                // 0 = oldest kept record
+			return Ring[(Count - GetKept() + i) & Mask];
+		}
+		
+		bool Save(string Path, unsigned int last = 0) const{         // "TRC1", record size, total count (u64), records
+			ofstream fout(Path, ios::out | ios::binary);
+			if(!fout.is_open()){ return false;}
+			
+			unsigned int n = GetKept(), first = 0;
+			if(last != 0 && last < n){ first = n - last;}
+			uint32_t size = sizeof(TraceRecord);
+			unsigned long long total = Count;
+			
+			fout.write("TRC1", 4);
+			fout.write(reinterpret_cast<const char*>(&size), 4);
+			fout.write(reinterpret_cast<const char*>(&total), 8);
+			for(unsigned int i = first; i < n; i++){ fout.write(reinterpret_cast<const char*>(&Get(i)), sizeof(TraceRecord));}
+			return true;
+		}
+};
+
+
+
+//======================================== Call Profiler ==================================
+
+// Shadow call stack of the CPU ("Cpu.AttachCalls(&Calls);"). JSR, BRK, IRQ and NMI open a frame,
+// RTS and RTI close every frame the stack pointer went back past, so a routine that drops its
+// return address or leaves through a jump doesn't derail it. The cycles between two events go
+// to the routine on top (exclusive), the call tree adds them up (inclusive). The tree is saved
+// as collapsed stacks ("root;MONITOR;SCAN 1234") for flame graph tools, named from a symbol file.
+
+#define CALL_JSR  0
+#define CALL_BRK  1
+#define CALL_IRQ  2
+#define CALL_NMI  3
+
+class CallProfiler {
+	private:
+		struct Node {
+			uint16_t Addr;
+			uint8_t Kind;
+			int Parent;
+			unsigned long long Self, Calls;
+		};
+		
+		vector<Node> Tree;                          // 0: root, the code outside of any call
+		unordered_map<uint64_t, int> Child;         // parent, kind and address -> node
+		unordered_map<int, string> Sym;             // address -> name
+		int Stack[256], Depth;                      // Stack[0] is the root
+		uint8_t StackS[256];                        // stack pointer before the call
+		unsigned long long Last, Lost;              // cycle of the last event, calls past the depth limit
+		
+		void Charge(unsigned long long cycle){ Tree[Stack[Depth-1]].Self += cycle - Last; Last = cycle;}
+		
+		string Name(int n) const{
+			const char *kind[] = { "", "BRK:", "IRQ:", "NMI:" };
+			if(n == 0){ return "root";}
+			unordered_map<int, string>::const_iterator s = Sym.find(Tree[n].Addr);
+			if(s != Sym.end()){ return s->second;}
+			char hex[16];
+			snprintf(hex, 16, "%s%04X", kind[Tree[n].Kind & 3], Tree[n].Addr);
+			return hex;
+		}
+		
+		string Frames(int n) const{                 // "root;...;name"
+			return Tree[n].Parent < 0 ? Name(n) : Frames(Tree[n].Parent) + ";" + Name(n);
+		}
+		
+	public:
+		CallProfiler(){ Clear();}
+		
+		void Clear(){
+			Node root = { 0, 0, -1, 0, 0 };
+			Tree.clear(); Child.clear();
+			Tree.push_back(root);
+			Stack[0] = 0; StackS[0] = 0xff; Depth = 1;
+			Last = 0; Lost = 0;
+		}
+		
+		bool LoadSymbols(string Path){              // "C0A3 SCAN" lines, hex address, # starts a comment
+			ifstream fin(Path);
+			if(!fin.is_open()){ return false;}
+			
+			string line;
+			unsigned int a; char name[64];
+			while(getline(fin, line)){
+				if(line.empty() || line[0] == '#'){ continue;}
+				if(sscanf(line.c_str(), "%x %63s", &a, name) == 2){ Sym[a & 0xffff] = name;}
+			}
+			return true;
+		}
+		
+		//---- CPU side ----
+		
+		void Call(uint16_t addr, uint8_t s, unsigned long long cycle, int kind){     // s: stack pointer before the call
+			Charge(cycle);
+			
+			int parent = Stack[Depth-1];
+			uint64_t key = (uint64_t(parent) << 24) | (uint64_t(kind) << 16) | addr;
+			unordered_map<uint64_t, int>::iterator c = Child.find(key);
+			int n;
+			if(c != Child.end()){ n = c->second;}
+			else{
+				Node node = { addr, uint8_t(kind), parent, 0, 0 };
+				n = int(Tree.size()); Tree.push_back(node);
+				Child[key] = n;
+			}
+			Tree[n].Calls++;
+			
+			if(Depth == 256){ Lost++; return;}
+			Stack[Depth] = n; StackS[Depth] = s; Depth++;
+		}
+		
+		void Return(uint8_t s, unsigned long long cycle){                            // s: stack pointer after the return
+			Charge(cycle);
+			while(Depth > 1 && StackS[Depth-1] <= s){ Depth--;}
+		}
+		
+		void Unwind(unsigned long long cycle){ Charge(cycle); Depth = 1;}          // reset
+		
+		//---- reports ----
+		
+		void Sync(unsigned long long cycle){ Charge(cycle);}     // the cycles since the last event, before a report
+		
+		bool SaveCollapsed(string Path) const{       // one "frame;frame;frame cycles" line per stack (exclusive)
+			ofstream fout(Path, ios::out);
+			if(!fout.is_open()){ return false;}
+			for(size_t n = 0; n < Tree.size(); n++){
+				if(Tree[n].Self != 0){ fout << Frames(int(n)) << " " << Tree[n].Self << "\n";}
+			}
+			return true;
+		}
+		
+		void Print(int top) const{                   // routines by exclusive cycles
+			vector<unsigned long long> incl(Tree.size(), 0);
+			for(size_t n = Tree.size(); n-- > 0; ){                        // children always come after their parents
+				incl[n] += Tree[n].Self;
+				if(Tree[n].Parent >= 0){ incl[Tree[n].Parent] += incl[n];}
+			}
+			
+			map<string, unsigned long long> Self, Incl, Calls;              // per routine, recursion counted once
+			unsigned long long total = incl[0];
+			for(size_t n = 0; n < Tree.size(); n++){
+				string name = Name(int(n));
+				Self[name] += Tree[n].Self; Calls[name] += Tree[n].Calls;
+				
+				bool outer = true;
+				for(int p = Tree[n].Parent; p >= 0 && outer; p = Tree[p].Parent){ outer = (Name(p) != name);}
+				if(outer){ Incl[name] += incl[n];}
+			}
+			
+			vector< pair<unsigned long long, string> > order;
+			for(map<string, unsigned long long>::iterator i = Self.begin(); i != Self.end(); i++){ order.push_back(make_pair(i->second, i->first));}
+			sort(order.rbegin(), order.rend());
+			
+			printf("\n==== Routines (%llu cycles) ====\n", total);
+			printf("%-16s %10s %14s %7s %14s %7s\n", "routine", "calls", "exclusive", "%", "inclusive", "%");
+			for(int i = 0; i < top && i < int(order.size()); i++){
+				const string &name = order[i].second;
+				printf("%-16s %10llu %14llu %6.1f%% %14llu %6.1f%%\n", name.c_str(), Calls[name], Self[name],
+				       total ? Self[name] * 100.0 / total : 0.0, Incl[name], total ? Incl[name] * 100.0 / total : 0.0);
+			}
+			if(Lost != 0){ printf("(%llu calls deeper than 256 frames not tracked)\n", Lost);}
+			printf("================================\n\n");
+		}
+};
+
+
+
+//======================================== Code Coverage ==================================
+
+// Which addresses the CPU started an instruction at, how often, and which way every branch went
+// ("Cpu.AttachCoverage(&Cover);"). One increment per instruction and one bit per branch. The
+// counts also show the hot code (GetCount), the csv export keeps only the executed addresses.
+
+class Coverage {
+	private:
+		uint32_t Count[65536];              // instructions started at the address
+		uint8_t Taken[8192], NotTaken[8192];         // one bit per address
+		
+		bool Bit(const uint8_t *map, uint16_t addr) const{ return (map[addr >> 3] >> (addr & 7)) & 1;}
+		
+	public:
+		Coverage(){ Clear();}
+		
+		void Clear(){
+			memset(Count, 0, sizeof(Count));
+			memset(Taken, 0, sizeof(Taken)); memset(NotTaken, 0, sizeof(NotTaken));
+		}
+		
+		//---- CPU side ----
+		
+		void Exec(uint16_t addr){ Count[addr]++;}
+		void Branch(uint16_t addr, bool taken){ (taken ? Taken : NotTaken)[addr >> 3] |= 1 << (addr & 7);}
+		
+		//---- results ----
+		
+		bool Executed(uint16_t addr) const{ return Count[addr] != 0;}
+		uint32_t GetCount(uint16_t addr) const{ return Count[addr];}
+		bool WasTaken(uint16_t addr) const{ return Bit(Taken, addr);}
+		bool WasNotTaken(uint16_t addr) const{ return Bit(NotTaken, addr);}
+		
+		bool SaveBinary(string Path) const{          // "COV1", executed bitmap, taken, not taken (8KB each), counts (u32)
+			ofstream fout(Path, ios::out | ios::binary);
+			if(!fout.is_open()){ return false;}
+			
+			uint8_t exec[8192];
+			memset(exec, 0, 8192);
+			for(int i = 0; i < 65536; i++){ if(Count[i] != 0){ exec[i >> 3] |= 1 << (i & 7);}}
+			
+			fout.write("COV1", 4);
+			fout.write(reinterpret_cast<const char*>(exec), 8192);
+			fout.write(reinterpret_cast<const char*>(Taken), 8192);
+			fout.write(reinterpret_cast<const char*>(NotTaken), 8192);
+			fout.write(reinterpret_cast<const char*>(Count), sizeof(Count));
+			return true;
+		}
+		
+		bool SaveCsv(string Path) const{             // executed addresses only
+			ofstream fout(Path, ios::out);
+			if(!fout.is_open()){ return false;}
+			fout << "address,count,taken,not_taken\n";
+			char line[64];
+			for(int i = 0; i < 65536; i++){
+				if(Count[i] != 0){
+					snprintf(line, 64, "%04x,%u,%d,%d\n", i, Count[i], int(Bit(Taken, i)), int(Bit(NotTaken, i)));
+					fout << line;
+				}
+			}
+			return true;
+		}
+		
+		void PrintSummary(uint16_t lo, uint16_t hi) const{          // lo-hi inclusive
+			unsigned long long insts = 0;
+			int addrs = 0, both = 0, onlyT = 0, onlyN = 0;
+			for(int i = lo; i <= hi; i++){
+				if(Count[i] == 0){ continue;}
+				addrs++; insts += Count[i];
+				bool t = Bit(Taken, i), n = Bit(NotTaken, i);
+				if(t && n){ both++;}
+				else if(t){ onlyT++;}
+				else if(n){ onlyN++;}
+			}
+			printf("\n==== Coverage $%04x-$%04x ====\n", lo, hi);
+			printf("instruction addresses  %d  (%llu instructions)\n", addrs, insts);
+			printf("branches               %d  both ways %d, only taken %d, never taken %d\n", both + onlyT + onlyN, both, onlyT, onlyN);
+			for(int i = lo; i <= hi; i++){
+				if(Count[i] == 0){ continue;}
+				bool t = Bit(Taken, i), n = Bit(NotTaken, i);
+				if(t != n){ printf("  $%04x  %s\n", i, t ? "always taken" : "never taken");}
+			}
+			printf("===============================\n\n");
+		}
+};
+
+
+
+//======================================== Interrupt Timing ===============================
+
+// Cycle counts in buckets: exact up to 255, then one bucket per power of two.
+
+class CycleHistogram {
+	private:
+		unsigned long long Exact[256], Log[64];
+		unsigned long long Count, Sum, Min, Max;
+		
+		static int Top(unsigned long long v){ int b = 0; while(v >>= 1){ b++;} return b;}     // highest set bit
+		
+	public:
+		CycleHistogram(){ Clear();}
+		
+		void Clear(){
+			memset(Exact, 0, sizeof(Exact)); memset(Log, 0, sizeof(Log));
+			Count = Sum = Max = 0; Min = ~0ULL;
+		}
+		
+		void Add(unsigned long long v){
+			if(v < 256){ Exact[v]++;} else{ Log[Top(v)]++;}
+			Count++; Sum += v;
+			if(v < Min){ Min = v;}
+			if(v > Max){ Max = v;}
+		}
+		
+		unsigned long long GetCount() const{ return Count;}
+		unsigned long long GetMin() const{ return Count ? Min : 0;}
+		unsigned long long GetMax() const{ return Max;}
+		double GetMean() const{ return Count ? double(Sum) / Count : 0.0;}
+		
+		unsigned long long Percentile(double p) const{             // lower bound of the bucket, p 0-100
+			unsigned long long want = (unsigned long long)(p / 100.0 * Count), seen = 0;
+			for(int i = 0; i < 256; i++){ seen += Exact[i]; if(seen > want){ return i;}}
+			for(int i = 8; i < 64; i++){ seen += Log[i]; if(seen > want){ return 1ULL << i;}}
+			return Max;
+		}
+		
+		void Print(const char *name) const{
+			if(Count == 0){ printf("%-10s -\n", name); return;}
+			printf("%-10s n=%-8llu min %-6llu mean %-9.1f p50 %-6llu p99 %-6llu max %llu\n", name, Count, GetMin(), GetMean(),
+			       Percentile(50), Percentile(99), Max);
+		}
+};
+
+// Interrupt timing per source ("Cpu.AttachInterrupts(&Ints);"). The CPU reports when a request
+// becomes pending, when the vector is fetched, when the handler starts and every RTI. Latency
+// is pending to the handler's first instruction, Vector pending to the vector fetch, Duration
+// the handler's first instruction to the end of its RTI. BRK only has a duration. Handlers are
+// matched to RTIs through the stack pointer, like the call profiler does. The CPU reports the
+// handler start and the RTI on their last cycle plus one, the cycle of the next opcode fetch.
+// Entering one handler drops the other source's pending request, as the CPU does.
+
+#define INT_IRQ  0
+#define INT_NMI  1
+#define INT_BRK  2
+
+class InterruptStats {
+	private:
+		CycleHistogram Latency[3], Vector[3], Duration[3];
+		unsigned long long PendingAt[3];            // ~0: nothing pending
+		struct Frame { int Src; uint8_t S; unsigned long long Start;} Stack[16];
+		int Depth;
+		
+	public:
+		InterruptStats(){ Clear();}
+		
+		void Clear(){
+			for(int i = 0; i < 3; i++){ Latency[i].Clear(); Vector[i].Clear(); Duration[i].Clear(); PendingAt[i] = ~0ULL;}
+			Depth = 0;
+		}
+		
+		//---- CPU side ----
+		
+		void Pending(int src, unsigned long long cycle){ if(PendingAt[src] == ~0ULL){ PendingAt[src] = cycle;}}
+		
+		void Cancel(int src){ PendingAt[src] = ~0ULL;}               // request dropped by the CPU
+		
+		void Fetch(int src, unsigned long long cycle){              // vector fetch
+			if(PendingAt[src] != ~0ULL){ Vector[src].Add(cycle - PendingAt[src]);}
+		}
+		
+		void Enter(int src, uint8_t s, unsigned long long cycle){   // s: stack pointer before the pushes, cycle: first handler fetch
+			if(PendingAt[src] != ~0ULL){ Latency[src].Add(cycle - PendingAt[src]); PendingAt[src] = ~0ULL;}
+			if(Depth == 16){ return;}
+			Stack[Depth].Src = src; Stack[Depth].S = s; Stack[Depth].Start = cycle; Depth++;
+		}
+		
+		void Return(uint8_t s, unsigned long long cycle){           // RTI, s: stack pointer after it, cycle: next fetch
+			while(Depth > 0 && Stack[Depth-1].S <= s){
+				Depth--;
+				Duration[Stack[Depth].Src].Add(cycle - Stack[Depth].Start);
+			}
+		}
+		
+		void Unwind(){ Depth = 0; for(int i = 0; i < 3; i++){ PendingAt[i] = ~0ULL;}}    // reset
+		
+		//---- results ----
+		
+		const CycleHistogram& GetLatency(int src) const{ return Latency[src];}
+		const CycleHistogram& GetVector(int src) const{ return Vector[src];}
+		const CycleHistogram& GetDuration(int src) const{ return Duration[src];}
+		
+		bool Any() const{ return Duration[0].GetCount() + Duration[1].GetCount() + Duration[2].GetCount() + Depth != 0;}
+		
+		void Print() const{                          // cycles
+			const char *names[] = { "IRQ", "NMI", "BRK" };
+			printf("\n==== Interrupts (cycles) ====\n");
+			for(int i = 0; i < 3; i++){
+				if(Latency[i].GetCount() + Duration[i].GetCount() == 0){ continue;}
+				printf("%s\n", names[i]);
+				if(i != INT_BRK){ Latency[i].Print("  latency"); Vector[i].Print("  vector");}
+				Duration[i].Print("  duration");
+			}
+			printf("=============================\n\n");
+		}
+};
+
+
+
 //======================================== CPU_6510 =======================================
 
 //--- Popular 8 bit processor ---
@@ -592,9 +1086,17 @@ class CPU_6510 : public Device {
 		uint16_t PC;                                   // program counter, address buffer (written to the AP bus on the every low edge of the clock)
 		
 		unsigned int cycle, Ireg;                      // cycles per instruction, Instruction (greater than 255 support is needed)
+		unsigned long long CycleCount;                 // total cycles since power up
+		unsigned long long InstCount;                  // instructions (and interrupt sequences) started
+		uint16_t InstPC;                               // address of the instruction being executed
 		bool LastClkState, IRQ_Pending, NMI_Pending;   // clock and Interrupts 
 		bool LastNmiLevel, RstRqs;                     // NMI is edge triggered (high->low) IRQ is level triggered (low), Reset processor request
 													   
+		TraceBuffer *TraceP;                           // instruction trace, NULL: off
+		CallProfiler *CallP;                           // shadow call stack, NULL: off
+		Coverage *CoverP;                              // executed addresses and branches, NULL: off
+		InterruptStats *IntP;                          // interrupt timing, NULL: off
+		
 		uint16_t AdBuf; uint8_t DtBuf; bool IoBuf;     // these are loaded to the address buss every low edge of the clock. 
 		                                               // DtBuf is always writen to on the high edge of the clock.
 													   
@@ -605,24 +1107,24 @@ class CPU_6510 : public Device {
 		//------- instruction pointers -------
 		
 		void (CPU_6510::*functionPtr[259])() = {
-			//0      1      2      3      4      5      6      7      8      9      A      B      C      D      E      F
-			BRK__, ORAix, NOP__, NOP__, NOP__, ORAzp, ASLzp, NOP__, PHP__, ORAim, ASL__, NOP__, NOP__, ORAab, ASLab, NOP__, // 0
-			BPLre, ORAiy, NOP__, NOP__, NOP__, ORAzx, ASLzx, NOP__, CLC__, ORAay, NOP__, NOP__, NOP__, ORAax, ASLax, NOP__, // 1
-			JSR__, ANDix, NOP__, NOP__, BITzp, ANDzp, ROLzp, NOP__, PLP__, ANDim, ROL__, NOP__, BITab, ANDab, ROLab, NOP__, // 2
-			BMIre, ANDiy, NOP__, NOP__, NOP__, ANDzx, ROLzx, NOP__, SEC__, ANDay, NOP__, NOP__, NOP__, ANDax, ROLax, NOP__, // 3
-			RTI__, EORix, NOP__, NOP__, NOP__, EORzp, LSRzp, NOP__, PHA__, EORim, LSR__, NOP__, JMPab, EORab, LSRab, NOP__, // 4
-			BVCre, EORiy, NOP__, NOP__, NOP__, EORzx, LSRzx, NOP__, CLI__, EORay, NOP__, NOP__, NOP__, EORax, LSRax, NOP__, // 5
-			RTS__, ADCix, NOP__, NOP__, NOP__, ADCzp, RORzp, NOP__, PLA__, ADCim, ROR__, NOP__, JMPin, ADCab, RORab, NOP__, // 6
-			BVSre, ADCiy, NOP__, NOP__, NOP__, ADCzx, RORzx, NOP__, SEI__, ADCay, NOP__, NOP__, NOP__, ADCax, RORax, NOP__, // 7
-			NOP__, STAix, NOP__, NOP__, STYzp, STAzp, STXzp, NOP__, DEY__, NOP__, TXA__, NOP__, STYab, STAab, STXab, NOP__, // 8
-			BCCre, STAiy, NOP__, NOP__, STYzx, STAzx, STXzy, NOP__, TYA__, STAay, TXS__, NOP__, NOP__, STAax, NOP__, NOP__, // 9
-			LDYim, LDAix, LDXim, NOP__, LDYzp, LDAzp, LDXzp, NOP__, TAY__, LDAim, TAX__, NOP__, LDYab, LDAab, NOP__, NOP__, // A
-			BCSre, LDAiy, NOP__, NOP__, LDYzx, LDAzx, LDXzy, NOP__, CLV__, LDAay, TSX__, NOP__, LDYax, LDAax, NOP__, NOP__, // B
-			CPYim, CMPix, NOP__, NOP__, CPYzp, CMPzp, DECzp, NOP__, INY__, CMPim, DEX__, NOP__, CPYab, CMPab, NOP__, NOP__, // C
-			BNEre, CMPiy, NOP__, NOP__, NOP__, CMPzx, DECzx, NOP__, CLD__, CMPay, NOP__, NOP__, NOP__, CMPax, NOP__, NOP__, // D
-			CPXim, SBCix, NOP__, NOP__, CPXzp, SBCzp, INCzp, NOP__, INX__, SBCim, NOP__, NOP__, CPXab, SBCab, NOP__, NOP__, // E
-			BEQre, SBCiy, NOP__, NOP__, NOP__, SBCzx, INCzx, NOP__, SED__, SBCay, NOP__, NOP__, NOP__, SBCax, NOP__, NOP__, // F
-			NMI__, RST__, IRQ__
+			//0                 1                 2                 3                 4                 5                 6                 7                 8                 9                 A                 B                 C                 D                 E                 F
+			&CPU_6510::BRK__, &CPU_6510::ORAix, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::ORAzp, &CPU_6510::ASLzp, &CPU_6510::NOP__, &CPU_6510::PHP__, &CPU_6510::ORAim, &CPU_6510::ASL__, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::ORAab, &CPU_6510::ASLab, &CPU_6510::NOP__, // 0
+			&CPU_6510::BPLre, &CPU_6510::ORAiy, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::ORAzx, &CPU_6510::ASLzx, &CPU_6510::NOP__, &CPU_6510::CLC__, &CPU_6510::ORAay, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::ORAax, &CPU_6510::ASLax, &CPU_6510::NOP__, // 1
+			&CPU_6510::JSR__, &CPU_6510::ANDix, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::BITzp, &CPU_6510::ANDzp, &CPU_6510::ROLzp, &CPU_6510::NOP__, &CPU_6510::PLP__, &CPU_6510::ANDim, &CPU_6510::ROL__, &CPU_6510::NOP__, &CPU_6510::BITab, &CPU_6510::ANDab, &CPU_6510::ROLab, &CPU_6510::NOP__, // 2
+			&CPU_6510::BMIre, &CPU_6510::ANDiy, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::ANDzx, &CPU_6510::ROLzx, &CPU_6510::NOP__, &CPU_6510::SEC__, &CPU_6510::ANDay, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::ANDax, &CPU_6510::ROLax, &CPU_6510::NOP__, // 3
+			&CPU_6510::RTI__, &CPU_6510::EORix, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::EORzp, &CPU_6510::LSRzp, &CPU_6510::NOP__, &CPU_6510::PHA__, &CPU_6510::EORim, &CPU_6510::LSR__, &CPU_6510::NOP__, &CPU_6510::JMPab, &CPU_6510::EORab, &CPU_6510::LSRab, &CPU_6510::NOP__, // 4
+			&CPU_6510::BVCre, &CPU_6510::EORiy, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::EORzx, &CPU_6510::LSRzx, &CPU_6510::NOP__, &CPU_6510::CLI__, &CPU_6510::EORay, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::EORax, &CPU_6510::LSRax, &CPU_6510::NOP__, // 5
+			&CPU_6510::RTS__, &CPU_6510::ADCix, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::ADCzp, &CPU_6510::RORzp, &CPU_6510::NOP__, &CPU_6510::PLA__, &CPU_6510::ADCim, &CPU_6510::ROR__, &CPU_6510::NOP__, &CPU_6510::JMPin, &CPU_6510::ADCab, &CPU_6510::RORab, &CPU_6510::NOP__, // 6
+			&CPU_6510::BVSre, &CPU_6510::ADCiy, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::ADCzx, &CPU_6510::RORzx, &CPU_6510::NOP__, &CPU_6510::SEI__, &CPU_6510::ADCay, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::ADCax, &CPU_6510::RORax, &CPU_6510::NOP__, // 7
+			&CPU_6510::NOP__, &CPU_6510::STAix, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::STYzp, &CPU_6510::STAzp, &CPU_6510::STXzp, &CPU_6510::NOP__, &CPU_6510::DEY__, &CPU_6510::NOP__, &CPU_6510::TXA__, &CPU_6510::NOP__, &CPU_6510::STYab, &CPU_6510::STAab, &CPU_6510::STXab, &CPU_6510::NOP__, // 8
+			&CPU_6510::BCCre, &CPU_6510::STAiy, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::STYzx, &CPU_6510::STAzx, &CPU_6510::STXzy, &CPU_6510::NOP__, &CPU_6510::TYA__, &CPU_6510::STAay, &CPU_6510::TXS__, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::STAax, &CPU_6510::NOP__, &CPU_6510::NOP__, // 9
+			&CPU_6510::LDYim, &CPU_6510::LDAix, &CPU_6510::LDXim, &CPU_6510::NOP__, &CPU_6510::LDYzp, &CPU_6510::LDAzp, &CPU_6510::LDXzp, &CPU_6510::NOP__, &CPU_6510::TAY__, &CPU_6510::LDAim, &CPU_6510::TAX__, &CPU_6510::NOP__, &CPU_6510::LDYab, &CPU_6510::LDAab, &CPU_6510::NOP__, &CPU_6510::NOP__, // A
+			&CPU_6510::BCSre, &CPU_6510::LDAiy, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::LDYzx, &CPU_6510::LDAzx, &CPU_6510::LDXzy, &CPU_6510::NOP__, &CPU_6510::CLV__, &CPU_6510::LDAay, &CPU_6510::TSX__, &CPU_6510::NOP__, &CPU_6510::LDYax, &CPU_6510::LDAax, &CPU_6510::NOP__, &CPU_6510::NOP__, // B
+			&CPU_6510::CPYim, &CPU_6510::CMPix, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::CPYzp, &CPU_6510::CMPzp, &CPU_6510::DECzp, &CPU_6510::NOP__, &CPU_6510::INY__, &CPU_6510::CMPim, &CPU_6510::DEX__, &CPU_6510::NOP__, &CPU_6510::CPYab, &CPU_6510::CMPab, &CPU_6510::NOP__, &CPU_6510::NOP__, // C
+			&CPU_6510::BNEre, &CPU_6510::CMPiy, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::CMPzx, &CPU_6510::DECzx, &CPU_6510::NOP__, &CPU_6510::CLD__, &CPU_6510::CMPay, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::CMPax, &CPU_6510::NOP__, &CPU_6510::NOP__, // D
+			&CPU_6510::CPXim, &CPU_6510::SBCix, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::CPXzp, &CPU_6510::SBCzp, &CPU_6510::INCzp, &CPU_6510::NOP__, &CPU_6510::INX__, &CPU_6510::SBCim, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::CPXab, &CPU_6510::SBCab, &CPU_6510::NOP__, &CPU_6510::NOP__, // E
+			&CPU_6510::BEQre, &CPU_6510::SBCiy, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::SBCzx, &CPU_6510::INCzx, &CPU_6510::NOP__, &CPU_6510::SED__, &CPU_6510::SBCay, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::NOP__, &CPU_6510::SBCax, &CPU_6510::NOP__, &CPU_6510::NOP__, // F
+			&CPU_6510::NMI__, &CPU_6510::RST__, &CPU_6510::IRQ__
 		};
 		
 		//------------ Internal port ---------
@@ -652,8 +1154,10 @@ class CPU_6510 : public Device {
 			EP = ep; CLK = clk; IRQ = irq; NMI = nmi;
 			
 			cycle = 0; SyncReg = 1; LastClkState = *CLK;
+			CycleCount = 0; InstCount = 0; InstPC = 0;
 			IRQ_Pending = NMI_Pending = false;
 			LastNmiLevel = *NMI;
+			TraceP = NULL; CallP = NULL; CoverP = NULL; IntP = NULL;
 			ResetRequest();
 		}
 		
@@ -666,13 +1170,20 @@ class CPU_6510 : public Device {
 		
 		void ResetRequest(){ RstRqs = true;}       // The next instruction cycle will be a reset one
 		
+		void AttachTrace(TraceBuffer *t){ TraceP = t;}     // NULL: no trace
+		void AttachCalls(CallProfiler *c){ CallP = c;}     // NULL: no call profile
+		void AttachCoverage(Coverage *c){ CoverP = c;}     // NULL: no coverage
+		void AttachInterrupts(InterruptStats *i){ IntP = i;}    // NULL: no interrupt timing
+		
 		void Evaluate(){                                                     // overloading the virtual function
 		
 			if(*NMI != LastNmiLevel && LastNmiLevel == 1){            // NMI trigger occured
+				if(IntP != NULL && !NMI_Pending){ IntP->Pending(INT_NMI, CycleCount);}
 				NMI_Pending = true; //cout << "Nmi\n";
 			}
 			
 			if(*IRQ == 0 && (Freg & 0x04) == 0){                      // IRQ trigger occured (IRQ disable flag is checked)
+				if(IntP != NULL && !IRQ_Pending){ IntP->Pending(INT_IRQ, CycleCount);}
 				IRQ_Pending = true;
 			}
 			
@@ -680,7 +1191,10 @@ class CPU_6510 : public Device {
 				
 				if(LastClkState == 1){                                       // (high->low) clock transition. Address bus is updated
 					if(cycle == 0){ AdBuf = PC; IoBuf = 1; SyncReg = 0;}
-					if(IoBuf == 0){ DP->Write(DtBuf);}
+					if(IoBuf == 0){
+						DP->Write(DtBuf);
+						if(TraceP != NULL){ TraceP->Write(AdBuf);}
+					}
 					*AP = AdBuf; *IOP = IoBuf; *SYNCP = SyncReg;
 					IoBuf = 1; SyncReg = 1;                                  // IoBuf has a strobe write protection
 				}
@@ -688,13 +1202,20 @@ class CPU_6510 : public Device {
 					ProcessPort();                                           // process the internal port (PP and DP)
 					DtBuf = *DP;
 					if(cycle == 0){                                          // Interrupt overwrites
-					    Ireg = DtBuf;
+					    Ireg = DtBuf; InstPC = PC; InstCount++;
 						if(RstRqs){ Ireg = 257;}                             // 1. Reset 
 						else if(NMI_Pending){ Ireg = 256;}                   // 2. NMI execution, NMI instruction (special system instruction)   
 						else if(IRQ_Pending){ Ireg = 258;}                   // 3. IRQ execution (BRK sets the 4'th bit of Freg)
+						
+						if(CoverP != NULL && Ireg < 256){ CoverP->Exec(InstPC);}
+						if(TraceP != NULL){
+							uint8_t kind = (Ireg == 256) ? TRACE_NMI : (Ireg == 257) ? TRACE_RESET : (Ireg == 258) ? TRACE_IRQ : 0;
+							TraceP->Begin(CycleCount, InstPC, DtBuf, kind, Areg, Xreg, Yreg, Sreg, Freg);
+						}
 					}
+					else if(TraceP != NULL){ TraceP->Read(*AP, DtBuf);}
 					(this->*functionPtr[Ireg])();                            // perform the cycle
-					cycle++;
+					cycle++; CycleCount++;
 				}
 			}
 			
@@ -704,21 +1225,388 @@ class CPU_6510 : public Device {
 		
 		uint16_t getOpcode(){ return Ireg;}
 		int getCycle(){ return cycle;}
+		uint16_t getInstPC(){ return InstPC;}
+		unsigned long long getCycleCount(){ return CycleCount;}
+		unsigned long long getInstCount(){ return InstCount;}
+		bool isImplemented(uint8_t op){ return op == 0xea || functionPtr[op] != &CPU_6510::NOP__;}   // false: runs as NOP
 };
 
 
+
+//======================================== Watchpoints ====================================
+
+#define WATCH_READ   0x01
+#define WATCH_WRITE  0x02
+#define WATCH_EXEC   0x04                   // opcode fetch (SYNC is low)
+#define WATCH_BREAK  0x80                   // stop the run on a hit (otherwise the hit is only logged)
+
+#define WATCH_LOG    256                    // ring buffer length (power of 2)
+
+struct WatchHit {
+	unsigned long long cycle;               // CPU cycle of the access
+	uint16_t addr, pc;                      // bus address, address of the instruction doing the access
+	uint8_t value, kind;                    // data on the bus, WATCH_READ/WRITE/EXEC
+};
+
+// Attach the table to every memory device that should be watched: "Ram.AttachProbe(&Watch);"
+// The table only traps the pages that hold a watchpoint, everything else runs untouched.
+
+class WatchTable : public MemoryProbe {
+	private:
+		CPU_6510 *Cpu;
+		StandardBus<bool> *CLK, *SYNC;      // an access spans two clock phases, it's logged on the low one
+		uint8_t Watch[65536];               // watch bits for every address
+		WatchHit Log[WATCH_LOG];
+		unsigned long LogCount;
+		bool Halt;
+		
+		void UpdatePage(uint16_t addr){
+			int base = addr & 0xff00;
+			PageTrap[addr >> 8] = 0;
+			for(int i = 0; i < 256; i++){ PageTrap[addr >> 8] |= Watch[base+i];}
+		}
+		
+	public:
+		WatchTable(CPU_6510 *cpu, StandardBus<bool> *clk, StandardBus<bool> *sync) : MemoryProbe() {
+			Cpu = cpu; CLK = clk; SYNC = sync;
+			memset(Watch, 0, 65536);
+			LogCount = 0; Halt = false;
+		}
+		
+		void Add(uint16_t addr, uint8_t kind, bool brk = false){     // kind: any combination of WATCH_READ/WRITE/EXEC
+			Watch[addr] = (kind & 0x07) | (brk ? WATCH_BREAK : 0);
+			UpdatePage(addr);
+		}
+		
+		void Remove(uint16_t addr){
+			Watch[addr] = 0;
+			UpdatePage(addr);
+		}
+		
+		void Access(uint16_t addr, uint8_t data, bool write){
+			if(*CLK != 0){ return;}                                  // second phase of the same access
+			
+			uint8_t kind = write ? WATCH_WRITE : (*SYNC == 0 ? WATCH_EXEC : WATCH_READ);
+			if((Watch[addr] & kind) == 0){ return;}                  // same page, different address
+			
+			WatchHit &h = Log[LogCount % WATCH_LOG];
+			h.cycle = Cpu->getCycleCount(); h.addr = addr; h.value = data; h.kind = kind;
+			h.pc = (kind == WATCH_EXEC) ? addr : Cpu->getInstPC();
+			LogCount++;
+			
+			if(Watch[addr] & WATCH_BREAK){ Halt = true;}
+		}
+		
+		bool Halted() const{ return Halt;}
+		
+		void Resume(){ Halt = false;}
+		
+		unsigned long GetHitCount() const{ return LogCount;}
+		
+		const WatchHit& GetHit(unsigned long n) const{               // 0 is the oldest hit still in the ring
+			unsigned long first = (LogCount > WATCH_LOG) ? LogCount - WATCH_LOG : 0;
+			return Log[(first + n) % WATCH_LOG];
+		}
+		
+		void PrintLog() const{
+			const char Kinds[][6] = { "", "READ", "WRITE", "", "EXEC" };
+			unsigned long n = (LogCount > WATCH_LOG) ? WATCH_LOG : LogCount;
+			
+			printf("\n==== Watch Hits ====\n");
+			for(unsigned long i = 0; i < n; i++){
+				const WatchHit &h = GetHit(i);
+				printf("%-5s  addr = %04x  value = %02x  PC = %04x  cycle = %llu\n", Kinds[h.kind], h.addr, h.value, h.pc, h.cycle);
+			}
+			printf("====================\n\n");
+		}
+};
+
+
+//======================================== Heatmap Profiler ===============================
+
+// Counts reads, writes and opcode fetches for every address of the devices it's attached to
+// ("Ram.AttachProbe(&Heat); Rom.AttachProbe(&Heat);"). Detached devices don't pay anything.
+
+class HeatProfiler : public MemoryProbe {
+	private:
+		StandardBus<bool> *CLK, *SYNC;      // an access spans two clock phases, it's counted on the low one
+		uint32_t Count[3][65536];           // reads, writes, fetches
+		
+		uint8_t Shade(uint32_t c, uint32_t max) const{           // logarithmic intensity
+			if(c == 0 || max == 0){ return 0;}
+			return uint8_t(55 + 200*log(1.0+c)/log(1.0+max));
+		}
+		
+	public:
+		HeatProfiler(StandardBus<bool> *clk, StandardBus<bool> *sync) : MemoryProbe() {
+			CLK = clk; SYNC = sync;
+			memset(PageTrap, 1, 256);                        // every page is profiled
+			Clear();
+		}
+		
+		void Clear(){ memset(Count, 0, sizeof(Count));}
+		
+		void Access(uint16_t addr, uint8_t /*data*/, bool write){
+			if(*CLK != 0){ return;}
+			Count[write ? 1 : (*SYNC == 0 ? 2 : 0)][addr]++;
+		}
+		
+		uint32_t GetReads(uint16_t addr) const{ return Count[0][addr];}
+		uint32_t GetWrites(uint16_t addr) const{ return Count[1][addr];}
+		uint32_t GetFetches(uint16_t addr) const{ return Count[2][addr];}
+		
+		bool SaveBinary(string Path) const{          // "HEAT" followed by the read, write and fetch arrays (u32)
+			ofstream fout(Path, ios::out | ios::binary);
+			if(!fout.is_open()){ return false;}
+			fout.write("HEAT", 4);
+			fout.write(reinterpret_cast<const char*>(Count), sizeof(Count));
+			return true;
+		}
+		
+		bool SaveCsv(string Path) const{             // only the addresses that were touched
+			ofstream fout(Path, ios::out);
+			if(!fout.is_open()){ return false;}
+			fout << "address,reads,writes,fetches\n";
+			char line[64];
+			for(int i = 0; i < 65536; i++){
+				if(Count[0][i] | Count[1][i] | Count[2][i]){
+					snprintf(line, 64, "%04x,%u,%u,%u\n", i, Count[0][i], Count[1][i], Count[2][i]);
+					fout << line;
+				}
+			}
+			return true;
+		}
+		
+		bool SaveImage(string Path) const{           // 256x256 PPM, one pixel per address, one row per page
+			ofstream fout(Path, ios::out | ios::binary);      // red = writes, green = reads, blue = fetches
+			if(!fout.is_open()){ return false;}
+			
+			uint32_t max[3] = {0, 0, 0};
+			for(int k = 0; k < 3; k++){
+				for(int i = 0; i < 65536; i++){ if(Count[k][i] > max[k]){ max[k] = Count[k][i];}}
+			}
+			
+			uint8_t *img = new uint8_t [65536*3];
+			for(int i = 0; i < 65536; i++){
+				img[i*3] = Shade(Count[1][i], max[1]);
+				img[i*3+1] = Shade(Count[0][i], max[0]);
+				img[i*3+2] = Shade(Count[2][i], max[2]);
+			}
+			fout << "P6\n256 256\n255\n";
+			fout.write(reinterpret_cast<char*>(img), 65536*3);
+			delete[] img;
+			return true;
+		}
+		
+		void PrintPages(int top) const{              // the busiest pages (fast path candidates)
+			unsigned long long Total[256]; int Order[256], i, j;
+			for(i = 0; i < 256; i++){
+				Total[i] = 0; Order[i] = i;
+				for(j = 0; j < 256; j++){ Total[i] += Count[0][i*256+j] + Count[1][i*256+j] + Count[2][i*256+j];}
+			}
+			for(i = 1; i < 256; i++){                                    // insertion sort, descending
+				for(j = i; j > 0 && Total[Order[j]] > Total[Order[j-1]]; j--){
+					int t = Order[j]; Order[j] = Order[j-1]; Order[j-1] = t;
+				}
+			}
+			printf("\n==== Busiest Pages ====\n");
+			for(i = 0; i < top && i < 256 && Total[Order[i]] != 0; i++){
+				printf("$%02x00   %llu\n", Order[i], Total[Order[i]]);
+			}
+			printf("=======================\n\n");
+		}
+};
+
+
+
+//======================================== Device Profiler ================================
+
+// Host time spent in the Evaluate() of every device of a tick list. Ticks are only counted,
+// every Nth tick the devices are timed one by one, which keeps the cost to a few percent at
+// the default rate. The kit only goes through here while a profiler is attached
+// ("Kit.Profile(&Prof);"), a slot whose device changes starts over.
+
+class DeviceProfiler {
+	private:
+		typedef std::chrono::steady_clock Timer;
+		
+		Device *Dev[32];                    // device of every slot at its last sample
+		double Ns[32];                      // sampled time
+		unsigned long long Samples[32], First[32];    // samples of the slot, first tick it was evaluated at
+		unsigned long long Ticks;
+		unsigned int Every, Left;
+		double Overhead;                    // ns of one clock read, taken out of every sample
+		Timer::time_point Mark;             // last report
+		
+		Device *Known[64];                  // names for the report
+		const char *KnownName[64];
+		int KnownCount;
+		
+	public:
+		DeviceProfiler(unsigned int every = 256){                   // sample every Nth tick
+			Every = every < 1 ? 1 : every;
+			KnownCount = 0;
+			
+			Overhead = 1e9;                                          // the cheapest of a few back to back reads
+			for(int i = 0; i < 100; i++){
+				Timer::time_point a = Timer::now(), b = Timer::now();
+				double ns = std::chrono::duration<double, std::nano>(b - a).count();
+				if(ns < Overhead){ Overhead = ns;}
+			}
+			Clear();
+		}
+		
+		void Clear(){
+			for(int i = 0; i < 32; i++){ Dev[i] = NULL; Ns[i] = 0; Samples[i] = 0; First[i] = 0;}
+			Ticks = 0; Left = Every;
+			Mark = Timer::now();
+		}
+		
+		void SetName(Device *d, const char *name){
+			for(int i = 0; i < KnownCount; i++){ if(Known[i] == d){ KnownName[i] = name; return;}}
+			if(KnownCount < 64){ Known[KnownCount] = d; KnownName[KnownCount++] = name;}
+		}
+		
+		void Evaluate(Device **System, int count){                  // one tick of the list
+			Ticks++;
+			if(--Left != 0){
+				for(int i = 0; i < count; i++){ System[i]->Evaluate();}
+				return;
+			}
+			Left = Every;
+			
+			Timer::time_point t = Timer::now(), u;
+			for(int i = 0; i < count && i < 32; i++){
+				System[i]->Evaluate();
+				u = Timer::now();
+				if(Dev[i] != System[i]){ Dev[i] = System[i]; Ns[i] = 0; Samples[i] = 0; First[i] = Ticks - Every + 1;}
+				Ns[i] += std::chrono::duration<double, std::nano>(u - t).count() - Overhead;
+				Samples[i]++;
+				t = u;
+			}
+			for(int i = 32; i < count; i++){ System[i]->Evaluate();}
+		}
+		
+		bool Due(double sec){                                       // true every sec seconds (periodic reports)
+			Timer::time_point now = Timer::now();
+			if(std::chrono::duration<double>(now - Mark).count() < sec){ return false;}
+			Mark = now;
+			return true;
+		}
+		
+		double GetNs(int slot) const{                               // average per call
+			return Samples[slot] == 0 ? 0 : Ns[slot] / Samples[slot];
+		}
+		unsigned long long GetCalls(int slot) const{ return Dev[slot] == NULL ? 0 : Ticks - First[slot] + 1;}
+		unsigned long long GetTicks() const{ return Ticks;}
+		
+		void Print() const{                                         // slowest first
+			int Order[32], n = 0, i, j;
+			double total = 0;
+			for(i = 0; i < 32; i++){ if(Dev[i] != NULL){ Order[n++] = i; total += GetNs(i);}}
+			for(i = 1; i < n; i++){                                      // insertion sort, descending
+				for(j = i; j > 0 && GetNs(Order[j]) > GetNs(Order[j-1]); j--){
+					int t = Order[j]; Order[j] = Order[j-1]; Order[j-1] = t;
+				}
+			}
+			
+			printf("\n==== Device Time (1 in %u ticks) ====\n", Every);
+			printf("%-12s %14s %9s %7s\n", "device", "calls", "ns/call", "share");
+			for(i = 0; i < n; i++){
+				const char *name = NULL;
+				for(j = 0; j < KnownCount; j++){ if(Known[j] == Dev[Order[i]]){ name = KnownName[j];}}
+				char slot[16];
+				if(name == NULL){ snprintf(slot, 16, "slot %d", Order[i]); name = slot;}
+				printf("%-12s %14llu %9.1f %6.1f%%\n", name, GetCalls(Order[i]), GetNs(Order[i]),
+				       total > 0 ? GetNs(Order[i]) * 100.0 / total : 0.0);
+			}
+			printf("%-12s %14llu %9.1f\n", "tick", Ticks, total);
+			printf("====================================\n\n");
+		}
+};
+
+
+
+//======================================== Dirty Rectangles ===============================
+
+// Drawing devices mark the parts of their picture they changed, the front end only uploads
+// those (or nothing). Rectangles that touch are merged, a full list collapses into its last entry.
+
+struct ScreenRect {
+	long x, y, w, h;
+};
+
+class DirtyTracker {
+	private:
+		ScreenRect Rect[16];
+		int Count;
+		
+		static void Join(ScreenRect &a, long x, long y, long w, long h){      // a = bounding box of a and (x,y,w,h)
+			long x2 = (a.x+a.w > x+w) ? a.x+a.w : x+w, y2 = (a.y+a.h > y+h) ? a.y+a.h : y+h;
+			if(x < a.x){ a.x = x;}
+			if(y < a.y){ a.y = y;}
+			a.w = x2 - a.x; a.h = y2 - a.y;
+		}
+		
+	public:
+		DirtyTracker(){ Count = 0;}
+		
+		void Mark(long x, long y, long w, long h){
+			for(int n = 0; n < Count; n++){
+				ScreenRect &a = Rect[n];
+				if(x <= a.x+a.w && a.x <= x+w && y <= a.y+a.h && a.y <= y+h){ Join(a, x, y, w, h); return;}
+			}
+			if(Count == 16){ Join(Rect[15], x, y, w, h); return;}
+			Rect[Count].x = x; Rect[Count].y = y; Rect[Count].w = w; Rect[Count].h = h;
+			Count++;
+		}
+		
+		void Mark(const DirtyTracker &Z){                    // everything Z has marked
+			for(int n = 0; n < Z.Count; n++){ Mark(Z.Rect[n].x, Z.Rect[n].y, Z.Rect[n].w, Z.Rect[n].h);}
+		}
+		
+		bool Empty() const{ return Count == 0;}
+		int GetCount() const{ return Count;}
+		const ScreenRect& Get(int n) const{ return Rect[n];}
+		void Clear(){ Count = 0;}
+};
+
+
+
 //======================================== Simple LED devices ===========================
 
 
 
+#define SEG_W    21                 // glyph box (every segment pixel of one digit)
+#define SEG_H    42
+#define SEG_TOP  2                  // the A segment starts 2 lines above the digit position
+
 class Segment8D : public Device {
 	private:
 		StandardBus<uint8_t> *A, *B;
 		StandardBus<bool> *E;      // enable chnages (active LOW)
+		Clock *CLK;                // strobe time stamps
 		uint8_t *VP, *ui, *uj;
 		long Lsize, i, j, k;
-		
-		int Discharge[8];
+		long PosX, PosY;           // screen position (dirty rectangles)
+		DirtyTracker *Dirty;
+		
+		long long Strobe[8];       // tick of the last strobe of every digit
+		uint8_t Pattern[8];        // and the pattern it was strobed with
+		long long Persist;         // ticks a digit stays lit after a strobe
+		
+		bool Shading;              // brightness from the duty cycle instead of on/off
+		float Gain;                // duty cycle that shows as full brightness = 1/Gain
+		long long OnTime[8][8];    // ticks every segment of every digit was lit this frame
+		long long LastT, FrameT;   // last port change, start of the frame
+		uint8_t LastA, LastB;      // port values since LastT
+		uint8_t SegOf[SEG_H*SEG_W];   // segment (bit number) of every glyph box pixel
+		
+		uint8_t *Glyph;            // all 256 patterns, pre-rendered once (SEG_W x SEG_H pixels each)
+		short Span[SEG_H*4][3];    // runs of segment pixels in the glyph box {line, first pixel, length}
+		int SpanCount;
+		int Shown[8];              // pattern on screen for every digit (-1 = nothing drawn yet)
+		uint32_t Shade[8][8];      // segment colors on screen in shading mode
 		
 		void DrawPixel(char Col){ 
 			*ui = Col; *(ui+3) = 0xff;
@@ -769,40 +1657,142 @@ class Segment8D : public Device {
 			
 			ui = uj + 12 + (Lsize*17); DrawSeg(0, bin & 0x02);   // G
 		}
+		
+		void BuildGlyphs(){
+			uint8_t *vp = VP; long ls = Lsize;
+			Glyph = new uint8_t [256*SEG_W*SEG_H*4];
+			memset(Glyph, 0, 256*SEG_W*SEG_H*4);
+			
+			Lsize = SEG_W*4;                                              // the pixel code above renders into the cache
+			for(int p = 0; p < 256; p++){ 
+				VP = Glyph + p*SEG_W*SEG_H*4;
+				DrawSeg(uint8_t(p), 0, SEG_TOP);
+			}
+			VP = vp; Lsize = ls;
+			
+			for(int b = 0; b < 8; b++){                                   // single segment glyphs give the segment map
+				uint8_t *g = Glyph + (1 << b)*SEG_W*SEG_H*4;
+				for(int p = 0; p < SEG_W*SEG_H; p++){ if(g[p*4] == 0xff){ SegOf[p] = b;}}
+			}
+			
+			SpanCount = 0;                                                // alpha is only set on segment pixels
+			for(int y = 0; y < SEG_H; y++){
+				for(int x = 0; x < SEG_W; x++){
+					if(Glyph[(y*SEG_W + x)*4 + 3] == 0){ continue;}
+					short *s = Span[SpanCount];
+					if(SpanCount > 0 && s[-3] == y && s[-2] + s[-1] == x){ s[-1]++;}     // extends the last run
+					else{ 
+						s[0] = y; s[1] = x; s[2] = 1;
+						SpanCount++;
+					}
+				}
+			}
+		}
+		
+		void DrawDigit(int n, long x, uint8_t bin){                      // row copies of a cached glyph
+			if(Shown[n] == bin){ return;}                                 // already on screen
+			Shown[n] = bin;
+			if(Dirty != NULL){ Dirty->Mark(PosX + x, PosY + 12 - SEG_TOP, SEG_W, SEG_H);}
+			
+			uint8_t *dst = VP + (4*x) + (Lsize*(12-SEG_TOP));
+			uint8_t *src = Glyph + bin*SEG_W*SEG_H*4;
+			for(int s = 0; s < SpanCount; s++){
+				memcpy(dst + Lsize*Span[s][0] + 4*Span[s][1], src + 4*(SEG_W*Span[s][0] + Span[s][1]), 4*Span[s][2]);
+			}
+		}
+		
+		void Integrate(long long now){                                    // on time of the interval that just ended
+			long long dt = now - LastT;
+			uint8_t sel = (LastB << 2) | 0x03;
+			
+			if(LastA != 0x00 && dt > 0){
+				for(int n = 0; n < 8; n++, sel = sel >> 1){
+					if((sel & 0x01) == 0x00){
+						for(int b = 0; b < 8; b++){ if(LastA & (1 << b)){ OnTime[n][b] += dt;}}
+					}
+				}
+			}
+			LastA = *A; LastB = *B; LastT = now;
+		}
+		
+		void ShadeDigit(int n, long x, const long long *on, long long frame){    // one color per segment
+			uint32_t Lut[8]; uint8_t px[4] = {0x38, 0x00, 0x00, 0xff};
+			
+			for(int b = 0; b < 8; b++){
+				float lvl = (frame > 0) ? Gain*on[b]/frame : 0.0f;
+				if(lvl > 1.0f){ lvl = 1.0f;}
+				px[0] = uint8_t(0x38 + (0xff-0x38)*lvl);
+				memcpy(&Lut[b], px, 4);                                   // byte order of the picture is kept
+			}
+			
+			if(Shown[n] == -1 && memcmp(Lut, Shade[n], sizeof(Lut)) == 0){ return;}     // same shades as last frame
+			memcpy(Shade[n], Lut, sizeof(Lut));
+			Shown[n] = -1;                                                // glyph mode has to redraw
+			if(Dirty != NULL){ Dirty->Mark(PosX + x, PosY + 12 - SEG_TOP, SEG_W, SEG_H);}
+			
+			uint8_t *dst = VP + (4*x) + (Lsize*(12-SEG_TOP));
+			for(int s = 0; s < SpanCount; s++){
+				uint32_t *d = reinterpret_cast<uint32_t*>(dst + Lsize*Span[s][0] + 4*Span[s][1]);
+				const uint8_t *m = SegOf + SEG_W*Span[s][0] + Span[s][1];
+				for(int p = 0; p < Span[s][2]; p++){ d[p] = Lut[m[p]];}     // table lookups only, vectorizes
+			}
+		}
 	
 	public:
-		Segment8D( StandardBus<uint8_t> *ap, StandardBus<uint8_t> *bp, StandardBus<bool> *ep, 
+		Segment8D( StandardBus<uint8_t> *ap, StandardBus<uint8_t> *bp, StandardBus<bool> *ep, Clock *clk,
 				   uint8_t *vp, long size, int x, int y) : Device(0) {
 					   
-			A = ap; B = bp; E = ep; VP = vp + (x*4) + (y*size); Lsize = size;
-			for(i = 0; i < 8; i++){ Discharge[i] = 1;} // by setting this to 1, all chars get the blank draw
+			A = ap; B = bp; E = ep; CLK = clk; VP = vp + (x*4) + (y*size); Lsize = size;
+			PosX = x; PosY = y; Dirty = NULL;
+			Persist = 100000;
+			for(i = 0; i < 8; i++){ Strobe[i] = -Persist; Pattern[i] = 0; Shown[i] = -1;}   // all chars get the blank draw
+			memset(SegOf, 0, sizeof(SegOf));
+			memset(Shade, 0, sizeof(Shade));
+			BuildGlyphs();
+			SetShading(false);
 		}
 		
-		void Evaluate(){
-			uint8_t locA = *A, locB = *B; long xpos = 252;
+		void SetDirty(DirtyTracker *d){ Dirty = d;}
+		
+		void SetShading(bool on, float gain = 6.0f){                      // gain: number of multiplexed digits
+			Shading = on; Gain = gain;
+			memset(OnTime, 0, sizeof(OnTime));
+			LastA = *A; LastB = *B; LastT = FrameT = CLK->GetTicks();
+		}
+		
+		~Segment8D(){
+			delete[] Glyph;
+		}
+		
+		void Evaluate(){                                                  // only port writes cost anything
+			if(Shading && (*A != LastA || *B != LastB)){ Integrate(CLK->GetTicks());}
+			if(*E != 0){ return;}
+			
+			uint8_t locA = *A, locB = *B;
 			locB = locB << 2; locB |= 0x03;                               // there's a shift in the schematics (shouldn't actually be here)
-
+			long long now = CLK->GetTicks();
 			
-			for(k = 0; k < 8; k++, xpos -= 32, locB = locB >> 1){
-				
-				if(k == 4){ xpos -= 17;}
-				
-				if(*E == 0){
-					if((locB & 0x01) == 0x00){ 
-						if(Discharge[k] == 0 || locA != 0x00){ 
-							DrawSeg(locA, xpos, 12);                     // strobe 
-							Discharge[k] = 100000;
-						}
+			for(k = 0; k < 8; k++, locB = locB >> 1){
+				if((locB & 0x01) == 0x00){ 
+					if(now - Strobe[k] >= Persist || locA != 0x00){       // strobe 
+						Strobe[k] = now; Pattern[k] = locA;
 					}
 				}
-				
-				if(Discharge[k] > 0){ 
-					Discharge[k]--;
-					if(Discharge[k] == 0){ DrawSeg(0x00, xpos, 12);}
-				}   // each segment has a discharge time
-				
+			}
+		}
+		
+		void Render(){                                                    // once per frame, before the picture is used
+			long long now = CLK->GetTicks(); long xpos = 252;
+			
+			if(Shading){ Integrate(now);}
+			
+			for(k = 0; k < 8; k++, xpos -= 32){
+				if(k == 4){ xpos -= 17;}
+				if(Shading){ ShadeDigit(k, xpos, OnTime[k], now - FrameT);}
+				else{ DrawDigit(k, xpos, (now - Strobe[k] < Persist) ? Pattern[k] : 0x00);}    // each segment has a discharge time
 			}
 			
+			if(Shading){ memset(OnTime, 0, sizeof(OnTime)); FrameT = now;}
 		}
 };
 
@@ -813,6 +1803,8 @@ class SquareLed : public Device {
 	private:
 		StandardBus<bool> *EP;
 		uint8_t *VP, *ui; long Lsize;
+		long PosX, PosY; int State;                   // screen position, drawn state (-1 = nothing drawn)
+		DirtyTracker *Dirty;
 		
 		void DrawPixel(char Col){ 
 			*ui = Col; *(ui+3) = 0xff;
@@ -834,12 +1826,19 @@ class SquareLed : public Device {
 	public:
 		SquareLed( StandardBus<bool> *ep, uint8_t *vp, long size, int x, int y) : Device(0) {
 			EP = ep; Lsize = size; VP = vp + (x*4) + (y*size);
+			PosX = x; PosY = y; State = -1; Dirty = NULL;
 		}
 		
 		// The LED device is given the enable pin, the main screen pointer, the bytes per line number, and the x/y coordinates
 		// on the screen.
 		
+		void SetDirty(DirtyTracker *d){ Dirty = d;}
+		
 		void Evaluate(){
+			if(State == int(*EP)){ return;}                  // unchanged, nothing to draw
+			State = *EP;
+			if(Dirty != NULL){ Dirty->Mark(PosX, PosY, 9, 9);}
+			
 			if(*EP == false){ DrawLed(0x38);}
 			else{ DrawLed(0xff);}
 		}
@@ -851,6 +1850,7 @@ class SquareLed : public Device {
 class VRAM_8_32 : public MemoryDevice<uint16_t, uint8_t> {
 	private:
 		uint8_t *VbuffP;                                            // pointer to bitmap data
+		DirtyTracker *Dirty;                                        // in pixels of the 32x32 bitmap
 		int Pallete[16][4] = {{  0,  0,  0,255},{255,255,255,255},{136,  0,  0,255},{170,255,238,255},
 					   		  {204, 68,204,255},{  0,204, 85,255},{  0,  0,170,255},{238,238,119,255},
 							  {221,136, 85,255},{102, 68,  0,255},{255,119,119,255},{ 51, 51, 51,255},
@@ -860,13 +1860,16 @@ class VRAM_8_32 : public MemoryDevice<uint16_t, uint8_t> {
 				   StandardBus<uint16_t> *ap,                      // The "*iop" argument is optional (is data readable)
 		           StandardBus<uint8_t> *dp, 
 				   StandardBus<bool> *iop ) : MemoryDevice<uint16_t, uint8_t>(id, ep, 10, ap, 8, dp, iop){
-			VbuffP = vp; Reset();
+			VbuffP = vp; Dirty = NULL; Reset();
 		}
 		
+		void SetDirty(DirtyTracker *d){ Dirty = d;}
+		
 		void Reset(){
 			int i;
 			for(i = 0; i < 1024; i++){ *(MemP+i) = 0x00;}
 			for(i = 0; i < 4096; i++){ *(VbuffP+i) = 0x00;}
+			if(Dirty != NULL){ Dirty->Mark(0, 0, 32, 32);}
 		}
 		
 		void Evaluate(){                                           // overloading the old evaluate function
@@ -876,10 +1879,179 @@ class VRAM_8_32 : public MemoryDevice<uint16_t, uint8_t> {
 				int tmp = addr << 2;
 				int tmp2 = *DP; tmp2 %= 16;
 				for(int i = 0; i < 4; i++,tmp++){ *(VbuffP+tmp) = char(Pallete[tmp2][3-i]);}
+				if(Dirty != NULL){ Dirty->Mark(addr & 31, addr >> 5, 1, 1);}
 			}
 		}			  
 };
 
+//======================================== BankedMemory ===================================
+
+// A window of the address space that can be switched between several banks of the same size.
+// Switching only swaps the memory pointer, nothing is copied. The bank register has its own
+// enable line (active LOW): writing it selects bank (data % banks), reading it returns the bank.
+// Anything holding on to the window has to go through operator[] (the DMA controller does).
+
+class BankedMemory : public MemoryDevice<uint16_t, uint8_t> {
+	private:
+		StandardBus<bool> *BEP;                                    // bank register enable
+		uint8_t **Bank;
+		int BankCount, Selected;
+		
+	public:
+		BankedMemory( int id, StandardBus<bool> *ep, int aw,          // "aw" is the window width
+		              StandardBus<uint16_t> *ap, StandardBus<uint8_t> *dp, StandardBus<bool> *iop,
+		              int banks, StandardBus<bool> *bep ) : MemoryDevice<uint16_t, uint8_t>(id, ep, aw, ap, 8, dp, iop){
+			
+			BEP = bep; BankCount = (banks < 1) ? 1 : banks; Selected = 0;
+			Bank = new uint8_t* [BankCount];
+			Bank[0] = MemP;                                            // bank 0 is the parent's memory
+			for(int i = 1; i < BankCount; i++){ Bank[i] = new uint8_t [size];}
+		}
+		
+		~BankedMemory(){
+			for(int i = 1; i < BankCount; i++){ delete[] Bank[i];}
+			MemP = Bank[0];                                            // the parent frees this one
+			delete[] Bank;
+		}
+		
+		void Select(int n){ Selected = n % BankCount; MemP = Bank[Selected];}    // O(1) bank switch
+		
+		int GetSelected() const{ return Selected;}
+		int GetBankCount() const{ return BankCount;}
+		uint8_t* GetBank(int n){ return Bank[n % BankCount];}
+		
+		void Evaluate(){
+			if(*BEP == 0){
+				if(*IOP == 0){ Select(*DP);}
+				else{ *DP = Selected;}
+			}
+			MemoryDevice<uint16_t, uint8_t>::Evaluate();
+		}
+};
+
+//======================================== DMA Controller =================================
+
+// Block copy/fill engine. The bytes are moved with host memmove/memset the moment a transfer is
+// started, the controller then stays busy for the configured number of CPU cycles and raises IRQ.
+//
+// Registers:  0/1 source lo/hi    2/3 destination lo/hi    4/5 length lo/hi (0 = 65536)    6 fill value
+//             7 control. Write: bit0 start, bit1 fill instead of copy, bit7 IRQ on completion
+//                        Read:  bit6 busy, bit7 done (reading the control register acknowledges it)
+//
+// The register strobes are taken on the high clock phase, so put the controller BEFORE the CPU in
+// the emulation list. It drives the IRQ collector bus, which must be reset at the start of each tick.
+
+struct DmaRegion {
+	MemoryDevice<uint16_t, uint8_t> *Dev;
+	uint32_t Base, Len;                      // CPU address window
+	bool Writable;
+};
+
+class DmaController : public Device {
+	private:
+		StandardBus<uint16_t> *AP;
+		StandardBus<uint8_t> *DP;
+		StandardBus<bool> *EP, *IOP, *CLK;
+		CollectorBitBus *IRQ;
+		
+		uint8_t Reg[8];
+		DmaRegion Region[8]; int RegionCount;
+		uint32_t CostSetup, CostPerByte;         // CPU cycles charged for a transfer
+		uint32_t Busy;                           // cycles left
+		bool Done, LastClk;
+		
+		uint8_t* Map(uint32_t addr, bool write, uint32_t &avail){    // host pointer and contiguous length
+			for(int i = 0; i < RegionCount; i++){
+				DmaRegion &r = Region[i];
+				if(addr >= r.Base && addr < r.Base + r.Len){
+					uint32_t off = (addr - r.Base) % r.Dev->GetSize();
+					avail = r.Base + r.Len - addr;
+					if(r.Dev->GetSize() - off < avail){ avail = r.Dev->GetSize() - off;}       // mirrored device
+					return (write && !r.Writable) ? NULL : &((*r.Dev)[off]);
+				}
+			}
+			avail = 1;                                                // open bus, one byte at a time
+			return NULL;
+		}
+		
+		void Transfer(){
+			uint32_t src = Reg[0] | (Reg[1] << 8), dst = Reg[2] | (Reg[3] << 8);
+			uint32_t len = Reg[4] | (Reg[5] << 8), n, sa, da;
+			if(len == 0){ len = 65536;}
+			Busy = CostSetup + CostPerByte*len;
+			
+			while(len > 0){
+				uint8_t *d = Map(dst, true, da);
+				n = (da < len) ? da : len;
+				if(dst + n > 65536){ n = 65536 - dst;}                 // the address space wraps around
+				
+				if(Reg[7] & 0x02){ 
+					if(d != NULL){ memset(d, Reg[6], n);}
+				}
+				else{
+					uint8_t *s = Map(src, false, sa);
+					if(sa < n){ n = sa;}
+					if(src + n > 65536){ n = 65536 - src;}
+					if(d != NULL){ 
+						if(s != NULL){ memmove(d, s, n);}
+						else{ memset(d, 0xff, n);}                      // unmapped source reads as 0xff
+					}
+					src = (src + n) & 0xffff;
+				}
+				dst = (dst + n) & 0xffff;
+				len -= n;
+			}
+			if(Busy == 0){ Done = true;}
+		}
+		
+	public:
+		DmaController( StandardBus<bool> *ep, StandardBus<uint16_t> *ap, StandardBus<uint8_t> *dp,
+		               StandardBus<bool> *iop, StandardBus<bool> *clk, CollectorBitBus *irq ) : Device(0) {
+			
+			EP = ep; AP = ap; DP = dp; IOP = iop; CLK = clk; IRQ = irq;
+			memset(Reg, 0, 8);
+			RegionCount = 0; CostSetup = 4; CostPerByte = 1;
+			Busy = 0; Done = false; LastClk = *CLK;
+		}
+		
+		bool AddRegion(MemoryDevice<uint16_t, uint8_t> *dev, uint32_t base, uint32_t len, bool writable = true){
+			if(RegionCount == 8){ return false;}
+			Region[RegionCount].Dev = dev; Region[RegionCount].Base = base;
+			Region[RegionCount].Len = len; Region[RegionCount].Writable = writable;
+			RegionCount++;
+			return true;
+		}
+		
+		void SetCost(uint32_t setup, uint32_t perbyte){ CostSetup = setup; CostPerByte = perbyte;}
+		
+		bool IsBusy() const{ return Busy != 0;}
+		
+		void Evaluate(){
+			bool clk = *CLK;
+			if(clk && !LastClk){                                          // once per CPU cycle
+				if(Busy != 0){ 
+					Busy--;
+					if(Busy == 0){ Done = true;}
+				}
+				if(*EP == 0){
+					int r = *AP & 0x07;
+					if(*IOP == 0){ 
+						Reg[r] = *DP;
+						if(r == 7 && (Reg[7] & 0x01) && Busy == 0){ Done = false; Transfer();}
+					}
+					else if(r == 7){ 
+						*DP = (Reg[7] & 0x3f) | (Busy ? 0x40 : 0x00) | (Done ? 0x80 : 0x00);
+						Done = false;
+					}
+					else{ *DP = Reg[r];}
+				}
+			}
+			LastClk = clk;
+			
+			if(Done && (Reg[7] & 0x80)){ IRQ->Write(false);}
+		}
+};
+
 //======================================== Keyboards ======================================
 
 //-------------- One byte keyboard -------------------
@@ -912,20 +2084,18 @@ class Keyboard_6502kit : public Device {
 		const int KeyMap[6][6] = {{99,99, 4,13,22,31}, {99,99, 3,12,21,30}, {27,25, 2,11,20,29},
 								  {18,34, 1,10,19,28}, { 9,16,32,14, 5,15}, { 0, 7,33,23,24, 6}};
 		
-	public:
-		Keyboard_6502kit( StandardBus<uint8_t> *ip, StandardBus<uint8_t> *op, int xpos, int ypos, int *xms, int *yms,
-						  int *code ) : Device(0) { 
-						  
-						  IB = ip; OB = op; posX = xpos; posY = ypos; 
-						  mouseX = xms; mouseY = yms; Code = code;
-		}
+		int lastX, lastY;                    // mouse position of the last hit test
+		int Idx;                             // key pressed with the mouse (-1 = none)
+		bool Held[36]; int HeldCount;        // keys pressed by the host keyboard
+		bool Idle;                           // nothing pressed and the port was released
+		int lastSel;                         // row select of the last output (-1 = output again)
+		uint8_t Lut[64];                     // port response for every row select value
 		
-		void Evaluate(){ 
-			int x, y, i, j, k, xB, yB, idx;
-			uint8_t tI, tO;
+		int HitTest(int mx, int my){         // key under the mouse or -1
+			int x, y, i, k, xB, yB;
 			
-			x = (*mouseX - posX);  xB = -1;
-			y = (*mouseY - posY);  yB = -1;
+			x = (mx - posX);  xB = -1;
+			y = (my - posY);  yB = -1;
 			
 			for(i = 19, k = 0; i <= 491; i += 59, k++){
 				if(i <= x && x <= (i+43)){ xB = k;}
@@ -935,27 +2105,83 @@ class Keyboard_6502kit : public Device {
 				if(i <= y && y <= (i+22)){ yB = k;}
 			}
 			
-			if(xB >= 0 && yB >= 0){
-				idx = xB + yB*9;
-				*Code = idx;
-				//cout << idx << endl;
-				
-				tI = *IB;
-				//cout << "xxx:" << int(tI) << endl;
-				for(i = 0; i < 6; i++, tI = tI >> 1){    // shift through all
+			if(xB >= 0 && yB >= 0){ return xB + yB*9;}
+			return -1;
+		}
+		
+		void AddKey(int key){                // matrix response of one key for all 64 row selects, ANDed in
+			int i, j, s;
+			uint8_t tO;
+			
+			for(s = 0; s < 64; s++){
+				tO = 0xff;                                 // (no row selected)
+				for(i = 0; i < 6; i++){                    // the highest selected row wins
 					
-					if((tI & 0x01) == 0x00){               // if the bit is zero, construct the result
+					if(((s >> i) & 0x01) == 0x00){         // if the bit is zero, construct the result
 						tO = 0xff;
-						for(j = 0; j < 6; j++){           // construct the lower 6 bits via shifting
+						for(j = 0; j < 6; j++){            // construct the lower 6 bits via shifting
 							tO = tO << 1;
-							if(idx != KeyMap[i][j]){ tO |= 0x01;}
+							if(key != KeyMap[i][j]){ tO |= 0x01;}
 						}
-						//cout << "zzz:" << int(tO) << endl;
-					}	
+					}
 				}
-				
-				*OB = tO;                 // transfer the result
+				Lut[s] &= tO;                              // several keys pull down together
+			}
+		}
+		
+		void BuildLut(){                     // response of everything pressed
+			memset(Lut, 0xff, sizeof(Lut));
+			if(Idx >= 0){ AddKey(Idx);}
+			for(int k = 0; k < 36 && HeldCount != 0; k++){ 
+				if(Held[k] && k != Idx){ AddKey(k);}
 			}
+			lastSel = -1;
+		}
+		
+	public:
+		Keyboard_6502kit( StandardBus<uint8_t> *ip, StandardBus<uint8_t> *op, int xpos, int ypos, int *xms, int *yms,
+						  int *code ) : Device(0) { 
+						  
+						  IB = ip; OB = op; posX = xpos; posY = ypos; 
+						  mouseX = xms; mouseY = yms; Code = code;
+						  lastX = lastY = -1; Idx = -1; lastSel = -1;
+						  for(int k = 0; k < 36; k++){ Held[k] = false;}
+						  HeldCount = 0; Idle = true;
+		}
+		
+		// Host keyboard input: key codes are the mouse codes (column + row*9), any number can be held.
+		
+		void Press(int key, bool down){
+			if(key < 0 || key >= 36 || Held[key] == down){ return;}
+			Held[key] = down;
+			HeldCount += down ? 1 : -1;
+			BuildLut();
+		}
+		
+		bool IsPressed(int key){ return key == Idx || (key >= 0 && key < 36 && Held[key]);}
+		
+		// The mouse is hit tested only when it moves (an input event), the matrix response comes from
+		// a table. While keys are pressed the port is written when the row select changes, after the
+		// last release it reads 0xff once more (no key) and is left alone.
+		
+		void Evaluate(){ 
+			if(*mouseX != lastX || *mouseY != lastY){
+				lastX = *mouseX; lastY = *mouseY;
+				Idx = HitTest(lastX, lastY);
+				if(Idx >= 0){ *Code = Idx;}
+				BuildLut();
+			}
+			
+			if(Idx < 0 && HeldCount == 0){ 
+				if(!Idle){ *OB = 0xff; Idle = true;}
+				return;
+			}
+			Idle = false;
+			
+			int sel = *IB & 0x3f;
+			if(sel == lastSel){ return;}
+			lastSel = sel;
+			*OB = Lut[sel];                      // transfer the result
 		}
 };
 
@@ -1002,14 +2228,115 @@ bool MemoryToFile(Type &Arr, int ArrSize, int ArrOffset, string Path, int NumEle
 	
 	size = sizeof(Arr[0]);  // (PRESENTATION NOTE) use of the overloaded [] operator! ----v
 	
+	char *buff = new char [65536]; int used = 0;        // elements are gathered and written in 64KB blocks
+	
 	for(count = 0; ((ArrOffset+count) < ArrSize) && (count < NumElem); count++){
-		fout.write(reinterpret_cast<char*>( &(Arr[ArrOffset+count]) ), size);     // (PRESENTATION NOTE) reinterpret
+		if(used + size > 65536){ fout.write(buff, used); used = 0;}
+		memcpy(buff + used, reinterpret_cast<char*>( &(Arr[ArrOffset+count]) ), size);     // (PRESENTATION NOTE) reinterpret
+		used += size;
 	}
+	fout.write(buff, used);
 	
+	delete[] buff;
 	fout.close();
 	return true;
 }
 
+//======================================== Delta Dumps ====================================
+
+// Streams the changes of a memory region to a file every "Interval" CPU cycles. Only the bytes
+// that changed since the previous dump (or since the baseline if Rolling is off) are written.
+// The region has to be contiguous (MemoryDevice objects and standard arrays are).
+//
+// File format (little endian):   "MDLT", u32 region offset, u32 region length (bytes)
+//                  every dump:   u64 cycle, u32 run count, runs of { u32 offset, u32 length, bytes }
+
+template <class Type>
+class DeltaDumper : public Device {                 // add it to the emulation list, or call Dump() yourself
+	private:
+		CPU_6510 *Cpu;
+		uint8_t *Region, *Base;                     // live memory and the baseline copy
+		uint32_t Offset, Length;
+		unsigned long long Interval, Next;
+		bool Rolling;
+		ofstream fout;
+		char *Out; unsigned long Used;              // output block
+		unsigned long long Flushed;                 // bytes already written to the file
+		
+		void Put(const void *p, unsigned long n){
+			if(Used + n > 1048576){ fout.write(Out, Used); Flushed += Used; Used = 0;}
+			if(n > 1048576){ fout.write(reinterpret_cast<const char*>(p), n); Flushed += n; return;}
+			memcpy(Out + Used, p, n); Used += n;
+		}
+		
+	public:
+		DeltaDumper( CPU_6510 *cpu, Type &Arr, int ArrOffset, int NumElem, string Path,
+		             unsigned long long interval, bool rolling = true ) : Device(0) {
+			
+			Cpu = cpu; Interval = interval; Rolling = rolling;
+			Region = reinterpret_cast<uint8_t*>( &(Arr[ArrOffset]) );
+			Offset = ArrOffset*sizeof(Arr[0]); Length = NumElem*sizeof(Arr[0]);
+			
+			Base = new uint8_t [Length];
+			Out = new char [1048576]; Used = 0; Flushed = 0;
+			
+			fout.open(Path, ios::out | ios::binary);
+			Put("MDLT", 4); Put(&Offset, 4); Put(&Length, 4);
+			Baseline();
+		}
+		
+		~DeltaDumper(){
+			Close();
+			delete[] Base; delete[] Out;
+		}
+		
+		bool IsOpen() const{ return fout.is_open();}
+		
+		void Baseline(){                            // the next dump is relative to the current contents
+			memcpy(Base, Region, Length);
+			Next = Cpu->getCycleCount() + Interval;
+		}
+		
+		void Dump(){
+			unsigned long long cycle = Cpu->getCycleCount();
+			uint32_t runs = 0, i = 0, start, end;
+			
+			Put(&cycle, 8);
+			unsigned long long head = Flushed + Used;                         // file position of the run count
+			Put(&runs, 4);                                                    // (patched below)
+			
+			while(i < Length){
+				while(i + 8 <= Length && memcmp(Region+i, Base+i, 8) == 0){ i += 8;}     // skip equal words
+				while(i < Length && Region[i] == Base[i]){ i++;}
+				if(i == Length){ break;}
+				
+				start = i; end = i;                                           // a run ends after 8 equal bytes
+				while(i < Length && i - end < 8){
+					if(Region[i] != Base[i]){ end = i + 1;}
+					i++;
+				}
+				uint32_t len = end - start;
+				Put(&start, 4); Put(&len, 4); Put(Region+start, len);
+				if(Rolling){ memcpy(Base+start, Region+start, len);}
+				runs++;
+			}
+			
+			if(head >= Flushed){ memcpy(Out + (head - Flushed), &runs, 4);}                // still in the block
+			else{ 
+				fout.seekp(head); fout.write(reinterpret_cast<char*>(&runs), 4); fout.seekp(0, ios::end);
+			}
+			Next = cycle + Interval;
+		}
+		
+		void Evaluate(){
+			if(Cpu->getCycleCount() >= Next){ Dump();}
+		}
+		
+		void Close(){
+			if(fout.is_open()){ fout.write(Out, Used); Flushed += Used; Used = 0; fout.close();}
+		}
+};
+
 //=========================================== END =========================================
 
 
@@ -0,0 +1,132 @@
+#include <cstdio>
+#include <cstdint>
+
+// 6502 opcode table and a one line disassembler for the tools around the emulator (benchmarks,
+// traces, coverage). The emulator itself doesn't use it, CPU_6510 decodes with its own table.
+
+//======================================== Opcode Table ===================================
+
+#define AM_IMP  0                   // implied
+#define AM_ACC  1                   // accumulator        ASL A
+#define AM_IMM  2                   // immediate          LDA #$12
+#define AM_ZP   3                   // zero page          LDA $12
+#define AM_ZPX  4                   //                    LDA $12,X
+#define AM_ZPY  5                   //                    LDX $12,Y
+#define AM_ABS  6                   // absolute           LDA $1234
+#define AM_ABX  7                   //                    LDA $1234,X
+#define AM_ABY  8                   //                    LDA $1234,Y
+#define AM_IND  9                   // indirect           JMP ($1234)
+#define AM_IZX  10                  //                    LDA ($12,X)
+#define AM_IZY  11                  //                    LDA ($12),Y
+#define AM_REL  12                  // relative           BNE $1234
+
+#define OP_PAGE   1                 // one more cycle when the indexed address crosses a page
+#define OP_BRANCH 2                 // one more cycle when taken, two when the target is on another page
+
+struct OpInfo {
+	const char *Name;               // "???" for the undocumented opcodes
+	uint8_t Mode;                   // AM_...
+	uint8_t Cycles;                 // base cycle count
+	uint8_t Flags;                  // OP_...
+};
+
+const OpInfo OpTable[256] = {
+		{"BRK", AM_IMP, 7, 0}, {"ORA", AM_IZX, 6, 0}, {"???", AM_IMP, 2, 0}, {"???", AM_IMP, 2, 0},   // 00
+		{"???", AM_IMP, 2, 0}, {"ORA", AM_ZP, 3, 0}, {"ASL", AM_ZP, 5, 0}, {"???", AM_IMP, 2, 0},   // 04
+		{"PHP", AM_IMP, 3, 0}, {"ORA", AM_IMM, 2, 0}, {"ASL", AM_ACC, 2, 0}, {"???", AM_IMP, 2, 0},   // 08
+		{"???", AM_IMP, 2, 0}, {"ORA", AM_ABS, 4, 0}, {"ASL", AM_ABS, 6, 0}, {"???", AM_IMP, 2, 0},   // 0C
+		{"BPL", AM_REL, 2, OP_BRANCH}, {"ORA", AM_IZY, 5, OP_PAGE}, {"???", AM_IMP, 2, 0}, {"???", AM_IMP, 2, 0},   // 10
+		{"???", AM_IMP, 2, 0}, {"ORA", AM_ZPX, 4, 0}, {"ASL", AM_ZPX, 6, 0}, {"???", AM_IMP, 2, 0},   // 14
+		{"CLC", AM_IMP, 2, 0}, {"ORA", AM_ABY, 4, OP_PAGE}, {"???", AM_IMP, 2, 0}, {"???", AM_IMP, 2, 0},   // 18
+		{"???", AM_IMP, 2, 0}, {"ORA", AM_ABX, 4, OP_PAGE}, {"ASL", AM_ABX, 7, 0}, {"???", AM_IMP, 2, 0},   // 1C
+		{"JSR", AM_ABS, 6, 0}, {"AND", AM_IZX, 6, 0}, {"???", AM_IMP, 2, 0}, {"???", AM_IMP, 2, 0},   // 20
+		{"BIT", AM_ZP, 3, 0}, {"AND", AM_ZP, 3, 0}, {"ROL", AM_ZP, 5, 0}, {"???", AM_IMP, 2, 0},   // 24
+		{"PLP", AM_IMP, 4, 0}, {"AND", AM_IMM, 2, 0}, {"ROL", AM_ACC, 2, 0}, {"???", AM_IMP, 2, 0},   // 28
+		{"BIT", AM_ABS, 4, 0}, {"AND", AM_ABS, 4, 0}, {"ROL", AM_ABS, 6, 0}, {"???", AM_IMP, 2, 0},   // 2C
+		{"BMI", AM_REL, 2, OP_BRANCH}, {"AND", AM_IZY, 5, OP_PAGE}, {"???", AM_IMP, 2, 0}, {"???", AM_IMP, 2, 0},   // 30
+		{"???", AM_IMP, 2, 0}, {"AND", AM_ZPX, 4, 0}, {"ROL", AM_ZPX, 6, 0}, {"???", AM_IMP, 2, 0},   // 34
+		{"SEC", AM_IMP, 2, 0}, {"AND", AM_ABY, 4, OP_PAGE}, {"???", AM_IMP, 2, 0}, {"???", AM_IMP, 2, 0},   // 38
+		{"???", AM_IMP, 2, 0}, {"AND", AM_ABX, 4, OP_PAGE}, {"ROL", AM_ABX, 7, 0}, {"???", AM_IMP, 2, 0},   // 3C
+		{"RTI", AM_IMP, 6, 0}, {"EOR", AM_IZX, 6, 0}, {"???", AM_IMP, 2, 0}, {"???", AM_IMP, 2, 0},   // 40
+		{"???", AM_IMP, 2, 0}, {"EOR", AM_ZP, 3, 0}, {"LSR", AM_ZP, 5, 0}, {"???", AM_IMP, 2, 0},   // 44
+		{"PHA", AM_IMP, 3, 0}, {"EOR", AM_IMM, 2, 0}, {"LSR", AM_ACC, 2, 0}, {"???", AM_IMP, 2, 0},   // 48
+		{"JMP", AM_ABS, 3, 0}, {"EOR", AM_ABS, 4, 0}, {"LSR", AM_ABS, 6, 0}, {"???", AM_IMP, 2, 0},   // 4C
+		{"BVC", AM_REL, 2, OP_BRANCH}, {"EOR", AM_IZY, 5, OP_PAGE}, {"???", AM_IMP, 2, 0}, {"???", AM_IMP, 2, 0},   // 50
+		{"???", AM_IMP, 2, 0}, {"EOR", AM_ZPX, 4, 0}, {"LSR", AM_ZPX, 6, 0}, {"???", AM_IMP, 2, 0},   // 54
+		{"CLI", AM_IMP, 2, 0}, {"EOR", AM_ABY, 4, OP_PAGE}, {"???", AM_IMP, 2, 0}, {"???", AM_IMP, 2, 0},   // 58
+		{"???", AM_IMP, 2, 0}, {"EOR", AM_ABX, 4, OP_PAGE}, {"LSR", AM_ABX, 7, 0}, {"???", AM_IMP, 2, 0},   // 5C
+		{"RTS", AM_IMP, 6, 0}, {"ADC", AM_IZX, 6, 0}, {"???", AM_IMP, 2, 0}, {"???", AM_IMP, 2, 0},   // 60
+		{"???", AM_IMP, 2, 0}, {"ADC", AM_ZP, 3, 0}, {"ROR", AM_ZP, 5, 0}, {"???", AM_IMP, 2, 0},   // 64
+		{"PLA", AM_IMP, 4, 0}, {"ADC", AM_IMM, 2, 0}, {"ROR", AM_ACC, 2, 0}, {"???", AM_IMP, 2, 0},   // 68
+		{"JMP", AM_IND, 5, 0}, {"ADC", AM_ABS, 4, 0}, {"ROR", AM_ABS, 6, 0}, {"???", AM_IMP, 2, 0},   // 6C
+		{"BVS", AM_REL, 2, OP_BRANCH}, {"ADC", AM_IZY, 5, OP_PAGE}, {"???", AM_IMP, 2, 0}, {"???", AM_IMP, 2, 0},   // 70
+		{"???", AM_IMP, 2, 0}, {"ADC", AM_ZPX, 4, 0}, {"ROR", AM_ZPX, 6, 0}, {"???", AM_IMP, 2, 0},   // 74
+		{"SEI", AM_IMP, 2, 0}, {"ADC", AM_ABY, 4, OP_PAGE}, {"???", AM_IMP, 2, 0}, {"???", AM_IMP, 2, 0},   // 78
+		{"???", AM_IMP, 2, 0}, {"ADC", AM_ABX, 4, OP_PAGE}, {"ROR", AM_ABX, 7, 0}, {"???", AM_IMP, 2, 0},   // 7C
+		{"???", AM_IMP, 2, 0}, {"STA", AM_IZX, 6, 0}, {"???", AM_IMP, 2, 0}, {"???", AM_IMP, 2, 0},   // 80
+		{"STY", AM_ZP, 3, 0}, {"STA", AM_ZP, 3, 0}, {"STX", AM_ZP, 3, 0}, {"???", AM_IMP, 2, 0},   // 84
+		{"DEY", AM_IMP, 2, 0}, {"???", AM_IMP, 2, 0}, {"TXA", AM_IMP, 2, 0}, {"???", AM_IMP, 2, 0},   // 88
+		{"STY", AM_ABS, 4, 0}, {"STA", AM_ABS, 4, 0}, {"STX", AM_ABS, 4, 0}, {"???", AM_IMP, 2, 0},   // 8C
+		{"BCC", AM_REL, 2, OP_BRANCH}, {"STA", AM_IZY, 6, 0}, {"???", AM_IMP, 2, 0}, {"???", AM_IMP, 2, 0},   // 90
+		{"STY", AM_ZPX, 4, 0}, {"STA", AM_ZPX, 4, 0}, {"STX", AM_ZPY, 4, 0}, {"???", AM_IMP, 2, 0},   // 94
+		{"TYA", AM_IMP, 2, 0}, {"STA", AM_ABY, 5, 0}, {"TXS", AM_IMP, 2, 0}, {"???", AM_IMP, 2, 0},   // 98
+		{"???", AM_IMP, 2, 0}, {"STA", AM_ABX, 5, 0}, {"???", AM_IMP, 2, 0}, {"???", AM_IMP, 2, 0},   // 9C
+		{"LDY", AM_IMM, 2, 0}, {"LDA", AM_IZX, 6, 0}, {"LDX", AM_IMM, 2, 0}, {"???", AM_IMP, 2, 0},   // A0
+		{"LDY", AM_ZP, 3, 0}, {"LDA", AM_ZP, 3, 0}, {"LDX", AM_ZP, 3, 0}, {"???", AM_IMP, 2, 0},   // A4
+		{"TAY", AM_IMP, 2, 0}, {"LDA", AM_IMM, 2, 0}, {"TAX", AM_IMP, 2, 0}, {"???", AM_IMP, 2, 0},   // A8
+		{"LDY", AM_ABS, 4, 0}, {"LDA", AM_ABS, 4, 0}, {"LDX", AM_ABS, 4, 0}, {"???", AM_IMP, 2, 0},   // AC
+		{"BCS", AM_REL, 2, OP_BRANCH}, {"LDA", AM_IZY, 5, OP_PAGE}, {"???", AM_IMP, 2, 0}, {"???", AM_IMP, 2, 0},   // B0
+		{"LDY", AM_ZPX, 4, 0}, {"LDA", AM_ZPX, 4, 0}, {"LDX", AM_ZPY, 4, 0}, {"???", AM_IMP, 2, 0},   // B4
+		{"CLV", AM_IMP, 2, 0}, {"LDA", AM_ABY, 4, OP_PAGE}, {"TSX", AM_IMP, 2, 0}, {"???", AM_IMP, 2, 0},   // B8
+		{"LDY", AM_ABX, 4, OP_PAGE}, {"LDA", AM_ABX, 4, OP_PAGE}, {"LDX", AM_ABY, 4, OP_PAGE}, {"???", AM_IMP, 2, 0},   // BC
+		{"CPY", AM_IMM, 2, 0}, {"CMP", AM_IZX, 6, 0}, {"???", AM_IMP, 2, 0}, {"???", AM_IMP, 2, 0},   // C0
+		{"CPY", AM_ZP, 3, 0}, {"CMP", AM_ZP, 3, 0}, {"DEC", AM_ZP, 5, 0}, {"???", AM_IMP, 2, 0},   // C4
+		{"INY", AM_IMP, 2, 0}, {"CMP", AM_IMM, 2, 0}, {"DEX", AM_IMP, 2, 0}, {"???", AM_IMP, 2, 0},   // C8
+		{"CPY", AM_ABS, 4, 0}, {"CMP", AM_ABS, 4, 0}, {"DEC", AM_ABS, 6, 0}, {"???", AM_IMP, 2, 0},   // CC
+		{"BNE", AM_REL, 2, OP_BRANCH}, {"CMP", AM_IZY, 5, OP_PAGE}, {"???", AM_IMP, 2, 0}, {"???", AM_IMP, 2, 0},   // D0
+		{"???", AM_IMP, 2, 0}, {"CMP", AM_ZPX, 4, 0}, {"DEC", AM_ZPX, 6, 0}, {"???", AM_IMP, 2, 0},   // D4
+		{"CLD", AM_IMP, 2, 0}, {"CMP", AM_ABY, 4, OP_PAGE}, {"???", AM_IMP, 2, 0}, {"???", AM_IMP, 2, 0},   // D8
+		{"???", AM_IMP, 2, 0}, {"CMP", AM_ABX, 4, OP_PAGE}, {"DEC", AM_ABX, 7, 0}, {"???", AM_IMP, 2, 0},   // DC
+		{"CPX", AM_IMM, 2, 0}, {"SBC", AM_IZX, 6, 0}, {"???", AM_IMP, 2, 0}, {"???", AM_IMP, 2, 0},   // E0
+		{"CPX", AM_ZP, 3, 0}, {"SBC", AM_ZP, 3, 0}, {"INC", AM_ZP, 5, 0}, {"???", AM_IMP, 2, 0},   // E4
+		{"INX", AM_IMP, 2, 0}, {"SBC", AM_IMM, 2, 0}, {"NOP", AM_IMP, 2, 0}, {"???", AM_IMP, 2, 0},   // E8
+		{"CPX", AM_ABS, 4, 0}, {"SBC", AM_ABS, 4, 0}, {"INC", AM_ABS, 6, 0}, {"???", AM_IMP, 2, 0},   // EC
+		{"BEQ", AM_REL, 2, OP_BRANCH}, {"SBC", AM_IZY, 5, OP_PAGE}, {"???", AM_IMP, 2, 0}, {"???", AM_IMP, 2, 0},   // F0
+		{"???", AM_IMP, 2, 0}, {"SBC", AM_ZPX, 4, 0}, {"INC", AM_ZPX, 6, 0}, {"???", AM_IMP, 2, 0},   // F4
+		{"SED", AM_IMP, 2, 0}, {"SBC", AM_ABY, 4, OP_PAGE}, {"???", AM_IMP, 2, 0}, {"???", AM_IMP, 2, 0},   // F8
+		{"???", AM_IMP, 2, 0}, {"SBC", AM_ABX, 4, OP_PAGE}, {"INC", AM_ABX, 7, 0}, {"???", AM_IMP, 2, 0}   // FC
+};
+
+const uint8_t OpLength[13] = { 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 2, 2, 2 };     // instruction bytes per mode
+
+inline bool OpDocumented(uint8_t op){ return OpTable[op].Name[0] != '?';}
+inline int OpBytes(uint8_t op){ return OpLength[OpTable[op].Mode];}
+
+//======================================== Disassembler ===================================
+
+// One instruction at pc into out (at least 16 chars), returns its length. b holds three
+// bytes (the instruction and what follows), branch targets are printed as absolute addresses.
+
+int Disasm6502(uint16_t pc, const uint8_t *b, char *out){
+	const OpInfo &o = OpTable[b[0]];
+	uint16_t w = b[1] | (b[2] << 8);
+	
+	switch(o.Mode){
+		case AM_IMP: sprintf(out, "%s", o.Name); break;
+		case AM_ACC: sprintf(out, "%s A", o.Name); break;
+		case AM_IMM: sprintf(out, "%s #$%02X", o.Name, b[1]); break;
+		case AM_ZP:  sprintf(out, "%s $%02X", o.Name, b[1]); break;
+		case AM_ZPX: sprintf(out, "%s $%02X,X", o.Name, b[1]); break;
+		case AM_ZPY: sprintf(out, "%s $%02X,Y", o.Name, b[1]); break;
+		case AM_ABS: sprintf(out, "%s $%04X", o.Name, w); break;
+		case AM_ABX: sprintf(out, "%s $%04X,X", o.Name, w); break;
+		case AM_ABY: sprintf(out, "%s $%04X,Y", o.Name, w); break;
+		case AM_IND: sprintf(out, "%s ($%04X)", o.Name, w); break;
+		case AM_IZX: sprintf(out, "%s ($%02X,X)", o.Name, b[1]); break;
+		case AM_IZY: sprintf(out, "%s ($%02X),Y", o.Name, b[1]); break;
+		case AM_REL: sprintf(out, "%s $%04X", o.Name, (uint16_t)(pc + 2 + int8_t(b[1]))); break;
+	}
+	return OpLength[o.Mode];
+}
+
+//=========================================== END =========================================
@@ -0,0 +1,491 @@
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+// Host side helpers: everything here runs around the emulation, not inside of it.
+// Include after DeviceLibrary.cpp.
+
+//======================================== Triple Buffer ==================================
+
+// The emulation thread publishes finished frames, the render thread takes the newest one.
+// Neither side ever waits for the other: there are three slots, one owned by the writer (Back),
+// one by the reader (Front) and one in the middle that is swapped atomically by both sides.
+// Every slot carries the dirty rectangles since the frame the reader took last, so a frame that
+// was replaced before it was taken doesn't lose its changes. The writer only copies the parts of
+// a slot that are out of date (Stale), not the whole picture.
+
+class TripleBuffer {
+	private:
+		uint8_t *Pix[3];
+		DirtyTracker Dirty[3];
+		DirtyTracker Pending;               // writer: changes since the last frame the reader took
+		DirtyTracker Stale[3];              // writer: parts of every slot that differ from the source
+		long Width, Height, Pitch, Size;
+		int Back, Front;
+		std::atomic<int> Middle;            // slot number | 4 when it holds a frame the reader has not taken
+
+	public:
+		TripleBuffer(long width, long height, long pitch){          // 32 bit pixels, pitch in bytes
+			Width = width; Height = height; Pitch = pitch; Size = pitch*height;
+			for(int i = 0; i < 3; i++){ 
+				Pix[i] = new uint8_t[Size]; memset(Pix[i], 0, Size);
+				Stale[i].Mark(0, 0, width, height);
+			}
+			Back = 0; Middle = 1; Front = 2;
+		}
+
+		~TripleBuffer(){
+			for(int i = 0; i < 3; i++){ delete[] Pix[i];}
+		}
+
+		//---- writer (emulation thread) ----
+
+		void Publish(const uint8_t *src, DirtyTracker &d){          // copies the changes, takes over d's rectangles
+			for(int i = 0; i < 3; i++){ Stale[i].Mark(d);}
+			
+			for(int n = 0; n < Stale[Back].GetCount(); n++){        // bring the slot up to date
+				const ScreenRect &r = Stale[Back].Get(n);
+				long x = r.x < 0 ? 0 : r.x, y = r.y < 0 ? 0 : r.y;
+				long w = (r.x + r.w > Width ? Width : r.x + r.w) - x, h = (r.y + r.h > Height ? Height : r.y + r.h) - y;
+				for(long k = y; w > 0 && k < y + h; k++){ memcpy(Pix[Back] + k*Pitch + x*4, src + k*Pitch + x*4, w*4);}
+			}
+			Stale[Back].Clear();
+			
+			Dirty[Back].Clear(); Dirty[Back].Mark(Pending); Dirty[Back].Mark(d);
+
+			int old = Middle.exchange(Back | 4, std::memory_order_acq_rel);
+			Back = old & 3;
+			if((old & 4) == 0){ Pending.Clear();}                   // the previous frame was taken
+			Pending.Mark(d); d.Clear();
+		}
+
+		//---- reader (render thread) ----
+
+		bool Acquire(){                                             // true: Front is a new frame
+			if((Middle.load(std::memory_order_relaxed) & 4) == 0){ return false;}
+
+			Front = Middle.exchange(Front, std::memory_order_acq_rel) & 3;
+			return true;
+		}
+
+		const uint8_t* GetFront() const{ return Pix[Front];}
+		const DirtyTracker& GetFrontDirty() const{ return Dirty[Front];}
+		long GetSize() const{ return Size;}
+};
+
+//======================================== Pacer ==========================================
+
+// Runs the emulation at a given clock rate in real time. Every slice asks for its tick budget:
+// the ticks that should have happened since the start minus the ones that did. After a stall
+// (debugger, window drag...) at most MaxLag worth of time is caught up, the rest is dropped.
+// Speed 1.0 is real time, 4.0 four times as fast, 0 runs unthrottled in fixed chunks.
+
+class Pacer {
+	private:
+		typedef std::chrono::steady_clock Timer;
+		
+		double Hz, TicksPerCycle, Speed;
+		double MaxLag;                             // seconds
+		Timer::duration Slice;
+		Timer::time_point Base, Wake, MarkTime;
+		unsigned long long Done, BaseDone, MarkDone, Chunk;
+		double Ratio;
+		
+		double TickRate(){ return Hz*TicksPerCycle*Speed;}
+		
+	public:
+		Pacer(double hz, double tpc = 2.0){         // hz: emulated CPU clock, tpc: ticks per CPU cycle
+			Hz = hz; TicksPerCycle = tpc; Speed = 1.0; MaxLag = 0.1;
+			Slice = std::chrono::milliseconds(10);
+			Chunk = (unsigned long long)(hz*tpc/100.0);    // unthrottled slice: 10ms worth
+			Done = 0; Ratio = 0;
+			Rebase();
+		}
+		
+		void Rebase(){                                      // time starts counting from now
+			Base = MarkTime = Wake = Timer::now();
+			BaseDone = MarkDone = Done;
+		}
+		
+		void SetSpeed(double s){ Speed = s; Rebase();}
+		void SetSlice(int ms){ Slice = std::chrono::milliseconds(ms);}
+		void SetMaxLag(double sec){ MaxLag = sec;}
+		
+		unsigned long long Budget(){                        // ticks to run now
+			if(Speed <= 0){ return Chunk;}
+			
+			double due = std::chrono::duration<double>(Timer::now() - Base).count() * TickRate();
+			double lag = due - double(Done - BaseDone);
+			if(lag <= 0){ return 0;}
+			
+			double cap = MaxLag * TickRate();
+			if(lag > cap){                                  // too far behind: forget the rest
+				Base += std::chrono::duration_cast<Timer::duration>(std::chrono::duration<double>((lag - cap) / TickRate()));
+				lag = cap;
+			}
+			return (unsigned long long)lag;
+		}
+		
+		void Ran(unsigned long long ticks){                 // report what was actually run
+			Done += ticks;
+			
+			Timer::time_point now = Timer::now();
+			double sec = std::chrono::duration<double>(now - MarkTime).count();
+			if(sec >= 0.5){                                 // speed ratio over half a second
+				Ratio = double(Done - MarkDone) / (sec * Hz * TicksPerCycle);
+				MarkTime = now; MarkDone = Done;
+			}
+		}
+		
+		void Wait(){                                        // sleep to the next slice (not unthrottled)
+			if(Speed <= 0){ return;}
+			
+			Wake += Slice;
+			Timer::time_point now = Timer::now();
+			if(Wake < now){ Wake = now;}                    // late, no sleep and no burst of slices
+			else{ std::this_thread::sleep_until(Wake);}
+		}
+		
+		unsigned long long TickAt(Timer::time_point t) const{     // emulated tick belonging to a host time
+			if(Speed <= 0 || t <= Base){ return (Speed <= 0) ? Done : BaseDone;}
+			return BaseDone + (unsigned long long)(std::chrono::duration<double>(t - Base).count() * Hz*TicksPerCycle*Speed);
+		}
+		
+		double GetRatio() const{ return Ratio;}             // achieved speed / real kit speed (1.0 = 1MHz)
+		double GetSpeed() const{ return Speed;}
+		unsigned long long GetTicks() const{ return Done;}
+};
+
+//======================================== Throughput Meter ===============================
+
+// Numbers for the window title: emulated MHz, ratio to the real kit, instructions per second,
+// busy time of the emulation and of the render thread, host frame time. The emulation thread
+// reports its totals after every slice, the render thread times its own work per frame and
+// composes the line a few times per second. Running behind the set speed is marked "SLOW".
+
+class ThroughputMeter {
+	private:
+		typedef std::chrono::steady_clock Timer;
+		
+		double Hz, TicksPerCycle, Target;
+		std::atomic<unsigned long long> Ticks, Insts, EmuNs;     // emulation thread, totals
+		
+		Timer::time_point Mark, RenderStart;                      // render thread
+		unsigned long long MarkTicks, MarkInsts, MarkEmu;
+		double RenderNs;
+		int Frames;
+		
+	public:
+		ThroughputMeter(double hz, double tpc = 2.0){
+			Hz = hz; TicksPerCycle = tpc; Target = 1.0;
+			Ticks = 0; Insts = 0; EmuNs = 0;
+			MarkTicks = MarkInsts = MarkEmu = 0;
+			RenderNs = 0; Frames = 0;
+			Mark = RenderStart = Timer::now();
+		}
+		
+		void SetTarget(double speed){ Target = speed;}             // Pacer speed, 0: unthrottled (never slow)
+		
+		//---- emulation thread ----
+		
+		void Slice(unsigned long long ticks, unsigned long long insts, Timer::duration busy){
+			Ticks.store(ticks, std::memory_order_relaxed);
+			Insts.store(insts, std::memory_order_relaxed);
+			EmuNs.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(busy).count(), std::memory_order_relaxed);
+		}
+		
+		//---- render thread ----
+		
+		void RenderBegin(){ RenderStart = Timer::now();}
+		void RenderEnd(bool frame){                                   // frame: something was presented
+			RenderNs += std::chrono::duration<double, std::nano>(Timer::now() - RenderStart).count();
+			if(frame){ Frames++;}
+		}
+		
+		bool Update(double sec, char *text, int len){               // new title every sec seconds
+			Timer::time_point now = Timer::now();
+			double dt = std::chrono::duration<double>(now - Mark).count();
+			if(dt < sec){ return false;}
+			
+			unsigned long long t = Ticks.load(std::memory_order_relaxed), i = Insts.load(std::memory_order_relaxed);
+			unsigned long long e = EmuNs.load(std::memory_order_relaxed);
+			
+			double mhz = (t - MarkTicks) / TicksPerCycle / dt / 1e6;
+			double ratio = mhz * 1e6 / Hz;
+			double mips = (i - MarkInsts) / dt / 1e6;
+			double emu = (e - MarkEmu) / (dt * 1e9) * 100.0;
+			double render = RenderNs / (dt * 1e9) * 100.0;
+			double frame = Frames > 0 ? dt * 1000.0 / Frames : 0;
+			bool slow = (Target > 0 && ratio < Target * 0.95);
+			
+			snprintf(text, len, "%s6502 kit  %.3f MHz (%.0f%%)  %.3f MIPS  emu %.0f%%  render %.0f%%  frame %.1f ms",
+			         slow ? "SLOW  " : "", mhz, ratio * 100.0, mips, emu, render, frame);
+			
+			Mark = now; MarkTicks = t; MarkInsts = i; MarkEmu = e;
+			RenderNs = 0; Frames = 0;
+			return true;
+		}
+};
+
+//======================================== Input Queue ====================================
+
+// Input events travel from the SDL thread to the emulation thread with the host time they
+// happened at. The emulation thread turns the time into a tick (Pacer::TickAt) and applies
+// the event inside the running slice, not at its start. One writer, one reader, no locks.
+
+#define INPUT_PRESS   1             // mouse button down at X,Y
+#define INPUT_RELEASE 2             // mouse button up
+#define INPUT_KEYDOWN 3             // kit key X pressed on the host keyboard
+#define INPUT_KEYUP   4             // kit key X released
+
+struct InputEvent {
+	std::chrono::steady_clock::time_point When;
+	int Type, X, Y;
+};
+
+class InputQueue {
+	private:
+		InputEvent Ring[256];
+		std::atomic<unsigned int> Head, Tail;          // Head: next to read, Tail: next to write
+		
+	public:
+		InputQueue(){ Head = 0; Tail = 0;}
+		
+		bool Push(int type, int x, int y, std::chrono::steady_clock::time_point when){   // writer, false: full
+			unsigned int t = Tail.load(std::memory_order_relaxed);
+			if(t - Head.load(std::memory_order_acquire) == 256){ return false;}
+			
+			InputEvent &e = Ring[t & 255];
+			e.When = when; e.Type = type; e.X = x; e.Y = y;
+			Tail.store(t + 1, std::memory_order_release);
+			return true;
+		}
+		
+		const InputEvent* Peek(){                      // reader, oldest event or NULL
+			unsigned int h = Head.load(std::memory_order_relaxed);
+			if(h == Tail.load(std::memory_order_acquire)){ return NULL;}
+			return &Ring[h & 255];
+		}
+		
+		void Pop(){ Head.store(Head.load(std::memory_order_relaxed) + 1, std::memory_order_release);}
+};
+
+//======================================== Key Binding ====================================
+
+// Host key (scancode) to kit key code (column + row*9, 0-35). The table starts empty, the front
+// end binds its defaults and a text file can override them, one "scancode code" pair per line
+// (# starts a comment, code -1 unbinds).
+
+class KeyBinding {
+	private:
+		int Map[512];
+		
+	public:
+		KeyBinding(){ Clear();}
+		
+		void Clear(){ for(int i = 0; i < 512; i++){ Map[i] = -1;}}
+		
+		void Bind(int scancode, int code){
+			if(scancode >= 0 && scancode < 512 && code >= -1 && code < 36){ Map[scancode] = code;}
+		}
+		
+		int Get(int scancode) const{                        // kit key or -1
+			if(scancode < 0 || scancode >= 512){ return -1;}
+			return Map[scancode];
+		}
+		
+		bool Load(const char *path){                        // false: no such file
+			ifstream fin(path);
+			if(!fin.is_open()){ return false;}
+			
+			string line;
+			int sc, code;
+			while(getline(fin, line)){
+				if(line.empty() || line[0] == '#'){ continue;}
+				if(sscanf(line.c_str(), "%d %d", &sc, &code) == 2){ Bind(sc, code);}
+			}
+			return true;
+		}
+};
+
+//======================================== VCD Bus Probe ==================================
+
+// Records busses on every change into a Value Change Dump file (GTKWave). It's a device: append
+// it to the tick list after the others, so it sees the settled values of every tick. The
+// emulation side only compares values and stores binary events into chunks, a writer thread
+// turns full chunks into text. When the writer is behind by all chunks the emulation waits for
+// it (GetStalls() counts these). Add the busses before the first tick, Close() ends the file.
+
+struct BusEvent {
+	unsigned long long Tick;
+	uint32_t Value;
+	uint32_t Channel;
+};
+
+class BusReader {                           // any StandardBus as a number
+	public:
+		virtual uint32_t Read() const = 0;
+		virtual ~BusReader(){}
+};
+
+template <class Carrier>
+class BusReaderOf : public BusReader {
+	private:
+		const StandardBus<Carrier> *B;
+		
+	public:
+		BusReaderOf(const StandardBus<Carrier> *b){ B = b;}
+		uint32_t Read() const{ return uint32_t(Carrier(*B));}
+};
+
+#define PROBE_CHUNK   16384                 // events per chunk
+#define PROBE_CHUNKS  8
+
+class BusProbe final : public Device {
+	private:
+		Clock *CLK;
+		string Path;
+		double NsPerTick;
+		
+		BusReader *Chan[64];
+		const char *Name[64];
+		int Bits[64], Count;
+		uint32_t Last[64];
+		bool Started, Closed;
+		
+		BusEvent *Chunk[PROBE_CHUNKS];
+		int Fill[PROBE_CHUNKS];                 // events in a full chunk
+		int Used;                               // events in the chunk being filled (Tail)
+		std::atomic<unsigned int> Head, Tail;   // Head: next chunk to write out, Tail: the one being filled
+		std::atomic<bool> Closing;
+		std::thread Writer;
+		ofstream Out;
+		unsigned long long Stalls, Events;
+		
+		static void Ident(int n, char *id){     // printable VCD identifier: ! " # ... then two characters
+			int i = 0;
+			do{ id[i++] = char(33 + n % 94); n /= 94;} while(n != 0);
+			id[i] = 0;
+		}
+		
+		void Start(){                           // header, initial values, writer thread
+			Started = true;
+			Out.open(Path, ios::out | ios::binary);
+			if(!Out.is_open()){ Closed = true; return;}
+			
+			char id[4];
+			Out << "$timescale 1ns $end\n$scope module kit $end\n";
+			for(int i = 0; i < Count; i++){
+				Ident(i, id);
+				Out << "$var wire " << Bits[i] << " " << id << " " << Name[i] << " $end\n";
+				Last[i] = ~Chan[i]->Read();             // every bus is recorded on the first tick
+			}
+			Out << "$upscope $end\n$enddefinitions $end\n";
+			
+			Writer = std::thread(&BusProbe::WriteOut, this);
+		}
+		
+		void Publish(){                         // hand the filled chunk to the writer
+			unsigned int t = Tail.load(std::memory_order_relaxed);
+			Fill[t % PROBE_CHUNKS] = Used;
+			Tail.store(t + 1, std::memory_order_release);
+			Used = 0;
+			
+			while(t + 1 - Head.load(std::memory_order_acquire) == PROBE_CHUNKS){      // no free chunk
+				Stalls++;
+				std::this_thread::yield();
+			}
+		}
+		
+		void WriteOut(){                        // writer thread
+			char *text = new char [PROBE_CHUNK * 64], *p;          // worst case: 32 bits, time stamp per event
+			char id[64][4];
+			unsigned long long tick = ~0ULL;
+			for(int i = 0; i < Count; i++){ Ident(i, id[i]);}
+			
+			while(true){
+				unsigned int h = Head.load(std::memory_order_relaxed);
+				if(h == Tail.load(std::memory_order_acquire)){
+					if(Closing.load(std::memory_order_acquire) && h == Tail.load(std::memory_order_acquire)){ break;}
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+					continue;
+				}
+				
+				const BusEvent *e = Chunk[h % PROBE_CHUNKS];
+				int n = Fill[h % PROBE_CHUNKS];
+				p = text;
+				for(int k = 0; k < n; k++, e++){
+					if(e->Tick != tick){
+						tick = e->Tick;
+						p += snprintf(p, 24, "#%llu\n", (unsigned long long)(tick * NsPerTick));
+					}
+					int bits = Bits[e->Channel];
+					if(bits == 1){ *p++ = '0' + (e->Value & 1);}
+					else{
+						*p++ = 'b';
+						for(int b = bits - 1; b >= 0; b--){ *p++ = '0' + ((e->Value >> b) & 1);}
+						*p++ = ' ';
+					}
+					for(const char *c = id[e->Channel]; *c != 0; c++){ *p++ = *c;}
+					*p++ = '\n';
+				}
+				Out.write(text, p - text);
+				Head.store(h + 1, std::memory_order_release);
+			}
+			Out.close();
+			delete[] text;
+		}
+		
+	public:
+		BusProbe(Clock *clk, string path, double nsPerTick = 500.0) : Device(0) {    // 1MHz kit: 2 ticks per us
+			CLK = clk; Path = path; NsPerTick = nsPerTick;
+			Count = 0; Used = 0; Stalls = 0; Events = 0;
+			Started = Closed = false;
+			Head = 0; Tail = 0; Closing = false;
+			for(int i = 0; i < PROBE_CHUNKS; i++){ Chunk[i] = new BusEvent [PROBE_CHUNK]; Fill[i] = 0;}
+		}
+		
+		~BusProbe(){
+			Close();
+			for(int i = 0; i < Count; i++){ delete Chan[i];}
+			for(int i = 0; i < PROBE_CHUNKS; i++){ delete[] Chunk[i];}
+		}
+		
+		template <class Carrier>
+		bool Add(const StandardBus<Carrier> *bus, const char *name, int bits){     // before the first tick
+			if(Started || Count == 64 || bits < 1 || bits > 32){ return false;}
+			Chan[Count] = new BusReaderOf<Carrier>(bus);
+			Name[Count] = name; Bits[Count++] = bits;
+			return true;
+		}
+		
+		void Evaluate(){
+			if(!Started){ Start();}
+			if(Closed){ return;}
+			
+			unsigned long long t = CLK->GetTicks();
+			for(int i = 0; i < Count; i++){
+				uint32_t v = Chan[i]->Read();
+				if(v == Last[i]){ continue;}
+				
+				Last[i] = v;
+				BusEvent &e = Chunk[Tail.load(std::memory_order_relaxed) % PROBE_CHUNKS][Used++];
+				e.Tick = t; e.Value = v; e.Channel = i;
+				Events++;
+				if(Used == PROBE_CHUNK){ Publish();}
+			}
+		}
+		
+		void Close(){                           // writes what's left and ends the file
+			if(!Started || Closed){ return;}
+			Closed = true;
+			if(Used != 0){ Publish();}
+			Closing = true;
+			Writer.join();
+		}
+		
+		unsigned long long GetEvents() const{ return Events;}
+		unsigned long long GetStalls() const{ return Stalls;}
+};
+
+//=========================================== END =========================================
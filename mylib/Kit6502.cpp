@@ -0,0 +1,205 @@
+// The 6502 kit as one object: busses, devices, memory map and the evaluation list.
+// main.cpp puts a window around it, headless.cpp runs it without one.
+// Include after DeviceLibrary.cpp.
+
+//======================================== Kit6502 ========================================
+
+class Kit6502 {
+	private:
+		uint8_t *OwnBuff;                  // picture memory when the host doesn't provide one
+
+	public:
+		//----------- Busses -----------
+
+		StandardBus<uint16_t>  CpuAddr;
+		StandardBus<uint8_t>   CpuData;
+		StandardBus<bool>      CpuIO, CpuSync, Nmi;
+		Clock                  Clk;
+
+		StandardBus<bool>      RamE, RomE, GpioE, Port0E, Port1E, Port2E, DmaE, BankE;   // enable lines
+		StandardBus<bool>      BankRegE;
+		StandardBus<uint16_t>  BankRegAddr;
+		StandardBus<bool>      ShftData, ShftClr;
+		StandardBus<bool>      LedData[8];
+		StandardBus<uint8_t>   PalData, GpioData, Port0Data, Port1Data, Port2Data;       // Pal data bus
+
+		CollectorBitBus        Irq, Null;       // unatached outputs can go here! It's a collector bus, therefore no errors
+
+		VccSource Vcc;
+		GndSource Gnd;
+
+		int MouseX, MouseY, Code;          // mouse click location and button code
+		uint8_t *VBuff;                    // 552x300 RGBA picture, 2208 bytes per line
+		DirtyTracker Dirty;                // changed parts of VBuff
+
+		//----------- Devices ----------
+
+		CPU_6510 Cpu;
+		MemoryDevice<uint16_t, uint8_t> Ram, Rom, Pal;
+		Splitter8 Splt;
+		LatchReg<uint8_t> Gpio;
+		TriGate<uint8_t> Port0;
+		LatchReg<uint8_t> Port1, Port2;
+		Keyboard_6502kit Key;
+		Segment8D Disp;
+		ShftReg8<bool> Shft;
+		NotGate Not;
+		Splitter8to1 Splt2;
+		Splitter8 LedSplt;
+		SquareLed *LedP[8];
+		WatchTable Watch;
+		Mapper<uint16_t> BankSel;
+		BankedMemory Bank;
+		DmaController Dma;
+
+		Device *System[32];                // evaluated every tick, optional devices are appended
+		int SystemCount;
+		DeviceProfiler *Prof;              // NULL: not profiled
+
+		Kit6502(uint8_t *vbuff = NULL) :   // NULL: the kit draws into its own memory (no window)
+			OwnBuff(vbuff == NULL ? new uint8_t[662400]() : NULL),
+			Clk(1,1),
+			VBuff(vbuff == NULL ? OwnBuff : vbuff),
+			Cpu(0, &CpuAddr, &CpuData, &CpuSync, &CpuIO, &Gnd, &Clk, &Irq, &Nmi),
+			Ram(1, &RamE, 15, &CpuAddr, 8, &CpuData, &CpuIO),
+			Rom(2, &RomE, 14, &CpuAddr, 8, &CpuData),                                  // ROM functionality
+			Pal(3, &Gnd, 16, &CpuAddr, 8, &PalData),
+			Splt(&PalData, &RomE, &RamE, &GpioE, &Port0E, &Port1E, &Port2E, &DmaE, &BankE),
+			Gpio(&CpuData, &GpioData, &GpioE),
+			Port0(&Port0Data, &CpuData, &Port0E),
+			Port1(&CpuData, &Port1Data, &Port1E),
+			Port2(&CpuData, &Port2Data, &Port2E),
+			Key(&Port1Data, &Port0Data, 18, 91, &MouseX, &MouseY, &Code),
+			Disp(&Port2Data, &Port1Data, &Port2E, &Clk, VBuff, 2208, 0, 0),
+			Shft(&Vcc, &ShftData, &CpuSync, &ShftClr),
+			Not(&ShftData, &Nmi),
+			Splt2(&Port1Data, &ShftClr, 6),
+			LedSplt(&GpioData, &LedData[0], &LedData[1], &LedData[2], &LedData[3],
+			                   &LedData[4], &LedData[5], &LedData[6], &LedData[7]),
+			Watch(&Cpu, &Clk, &CpuSync),                                             // watchpoints on the RAM and ROM paths
+			BankSel(&CpuAddr, &BankRegAddr, 0x8018, 0x8018, &BankRegE),              // bank register at $8018
+			Bank(4, &BankE, 13, &CpuAddr, &CpuData, &CpuIO, 16, &BankRegE),          // 16 x 8KB banks at $a000-$bfff
+			Dma(&DmaE, &CpuAddr, &CpuData, &CpuIO, &Clk, &Irq)                       // block copies, registers at $8010-$8017
+		{
+			CpuIO = true;
+			Null.Reset(); Irq.Reset();
+			MouseX = MouseY = 0; Code = -1;
+			Prof = NULL;
+
+			Disp.SetDirty(&Dirty);
+			for(int j = 315, i = 0; i < 8; i++, j+=19){
+				if(i == 4){ j += 16;}
+				LedP[i] = new SquareLed(&LedData[i], VBuff, 2208, j, 34);
+				LedP[i]->SetDirty(&Dirty);
+			}
+
+			Ram.AttachProbe(&Watch);
+			Rom.AttachProbe(&Watch);
+
+			Dma.AddRegion(&Ram, 0x0000, 0x8000);
+			Dma.AddRegion(&Bank, 0xa000, 0x2000);
+			Dma.AddRegion(&Rom, 0xc000, 0x4000, false);
+
+			Device *List[] = { &Dma, &Cpu, &Pal, &Splt, &Rom, &Ram, &BankSel, &Bank,
+			                   &Port1, &Key, &Port0, &Port2, &Disp, &Gpio, &Splt2, &Shft, &Not };
+			for(SystemCount = 0; SystemCount < 17; SystemCount++){ System[SystemCount] = List[SystemCount];}
+		}
+
+		~Kit6502(){
+			for(int i = 0; i < 8; i++){ delete LedP[i];}
+			delete[] OwnBuff;
+		}
+
+		static long FileSize(string Path){                 // -1: can't open
+			ifstream fin(Path, ios::in | ios::binary | ios::ate);
+			if(!fin.is_open()){ return -1;}
+			return long(fin.tellg());
+		}
+
+		// ROM and PAL images, then the memory map patches for the devices added since the PAL was made.
+		bool LoadSystem(string RomPath, string PalPath){
+			if(!FileToMemory(Rom, Rom[0], 16384, 0, RomPath, 0, 16384)){ return false;}
+			if(!FileToMemory(Pal, Pal[0], 65536, 0, PalPath, 0, 65536)){ return false;}
+
+			for(int a = 0x8010; a <= 0x8017; a++){ Pal[a] = 0xbf;}     // DMA registers (was a ROM mirror)
+			Pal[0x8018] = 0xff;                                         // bank register (decoded by BankSel)
+			for(int a = 0xa000; a <= 0xbfff; a++){ Pal[a] = 0x7f;}     // bank window
+			return true;
+		}
+
+		bool LoadProgram(string Path, int Addr, int Len = -1){       // into RAM, Len -1: the whole file
+			if(Len < 0){ Len = int(FileSize(Path));}
+			if(Len <= 0){ return false;}
+			return FileToMemory(Ram, Ram[0], Ram.GetSize(), Addr, Path, 0, Len);
+		}
+
+		void SetResetVector(uint16_t Addr){                          // start a program without the monitor
+			Rom[0x3ffc] = Addr & 0xff; Rom[0x3ffd] = Addr >> 8;
+		}
+
+		uint8_t Peek(uint16_t Addr){                                 // memory as the CPU sees it, decoded by the PAL
+			uint8_t sel = Pal[Addr];                                 // active low enables in Splt order
+			if((sel & 0x01) == 0){ return Rom[Addr & 0x3fff];}
+			if((sel & 0x02) == 0){ return Ram[Addr & 0x7fff];}
+			if((sel & 0x80) == 0){ return Bank[Addr & 0x1fff];}
+			return 0xff;                                             // ports, DMA, bank register, open bus
+		}
+
+		void Profile(DeviceProfiler *p){                             // time every device, NULL: stop
+			Prof = p;
+			if(p == NULL){ return;}
+
+			Device *List[] = { &Dma, &Cpu, &Pal, &Splt, &Rom, &Ram, &BankSel, &Bank,
+			                   &Port1, &Key, &Port0, &Port2, &Disp, &Gpio, &Splt2, &Shft, &Not };
+			const char *Names[] = { "Dma", "Cpu", "Pal", "Splt", "Rom", "Ram", "BankSel", "Bank",
+			                        "Port1", "Key", "Port0", "Port2", "Disp", "Gpio", "Splt2", "Shft", "Not" };
+			for(int i = 0; i < 17; i++){ p->SetName(List[i], Names[i]);}
+		}
+
+		void Tick(){                                                 // one clock half period
+
+			/*
+			Cpu.Evaluate();
+			Pal.Evaluate();
+			Splt.Evaluate();
+			Rom.Evaluate();
+			Ram.Evaluate();
+			Port1.Evaluate();
+			Key.Evaluate();
+			Port0.Evaluate();
+			Port2.Evaluate();
+			Disp.Evaluate();
+			Gpio.Evaluate();
+			Splt2.Evaluate();
+			Shft.Evaluate();
+			Not.Evaluate();
+			*/
+
+			Irq.Reset();                                             // IRQ sources drive the line every tick
+			if(Prof != NULL){ Prof->Evaluate(System, SystemCount);}
+			else{ for(int i = 0; i < SystemCount; i++){ System[i]->Evaluate();}}
+			Clk++;
+		}
+
+		void Frame(){                                                // picture parts that aren't clocked
+			Disp.Render();                                           // 7-segment digits that are still lit
+
+			LedSplt.Evaluate();
+			for(int i = 0; i < 8; i++){ LedP[i]->Evaluate();}        // LED object evaluation
+		}
+};
+
+
+void PrintCpu(CPU_6510 &Z){
+
+	printf("\n==== CPU Status ====\n");
+
+	printf("A = %02x   X = %02x   Y = %02x\n", Z.GetCpuReg(0), Z.GetCpuReg(1), Z.GetCpuReg(2));
+	printf("  S = %02x   PC = %04x\n", Z.GetCpuReg(3), Z.GetCpuReg(6));
+	printf("     F = %d%d%d%d%d%d%d%d\n", (Z.GetCpuReg(4)>>7)&0x01, (Z.GetCpuReg(4)>>6)&0x01, (Z.GetCpuReg(4)>>5)&0x01, (Z.GetCpuReg(4)>>4)&0x01,
+                                       	  (Z.GetCpuReg(4)>>3)&0x01, (Z.GetCpuReg(4)>>2)&0x01, (Z.GetCpuReg(4)>>1)&0x01, (Z.GetCpuReg(4))&0x01);
+
+	printf("====================\n\n\n");
+}
+
+//=========================================== END =========================================
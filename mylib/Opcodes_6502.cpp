@@ -115,6 +115,7 @@ void Branch(bool Z){
 	switch(cycle){
 		case 0: PC++; AdBuf = PC; PC++; IoBuf = 1; break;
 		case 1: if(Z){ PC = PC + char(DtBuf);} cycle = -1;
+				if(CoverP != NULL){ CoverP->Branch(InstPC, Z);}
 	}
 }
 
@@ -234,6 +235,8 @@ void RST__(){
 		case 1: PC = DtBuf; PC = PC << 8;
 				AdBuf = 0xfffc; break;
 		case 2: PC = PC + DtBuf; cycle = -1; RstRqs = false;
+				if(CallP != NULL){ CallP->Unwind(CycleCount);}
+				if(IntP != NULL){ IntP->Unwind();}
 	}
 }
 		
@@ -241,11 +244,15 @@ void NMI__(){
 	InterruptPush(0);
 	switch(cycle){
 		case 3: Freg = Freg | 0x04; break;
-		case 4: AdBuf = 0xfffb; IoBuf = 1; break;
+		case 4: AdBuf = 0xfffb; IoBuf = 1;
+				if(IntP != NULL){ IntP->Fetch(INT_NMI, CycleCount);}
+				break;
 		case 5: PC = DtBuf; PC = PC << 8;
 				AdBuf = 0xfffa; break;
-		case 6: PC = PC + DtBuf; Freg = Freg & 0xfb;
+		case 6: PC = PC + DtBuf;                        // irq stays disabled until RTI restores the flags
 				NMI_Pending = IRQ_Pending = false; cycle = -1;        
+				if(CallP != NULL){ CallP->Call(PC, Sreg + 3, CycleCount, CALL_NMI);}
+				if(IntP != NULL){ IntP->Enter(INT_NMI, Sreg + 3, CycleCount + 1); IntP->Cancel(INT_IRQ);}
 	}
 }
 
@@ -254,11 +261,15 @@ void IRQ__(){
 	switch(cycle){
 		case 0: Freg = Freg & 0xef; break;          // hot injection (Freg hasn't been pushed yet)
 		case 3: Freg = Freg | 0x04; break;          // disable irq
-		case 4: AdBuf = 0xffff; IoBuf = 1; break;
+		case 4: AdBuf = 0xffff; IoBuf = 1;
+				if(IntP != NULL){ IntP->Fetch(INT_IRQ, CycleCount);}
+				break;
 		case 5: PC = DtBuf; PC = PC << 8;
 				AdBuf = 0xfffe; break;
-		case 6: PC = PC + DtBuf; Freg = Freg & 0xfb;    // reenable irq
+		case 6: PC = PC + DtBuf;                        // irq stays disabled until RTI restores the flags
 				NMI_Pending = IRQ_Pending = false; cycle = -1;      
+				if(CallP != NULL){ CallP->Call(PC, Sreg + 3, CycleCount, CALL_IRQ);}
+				if(IntP != NULL){ IntP->Enter(INT_IRQ, Sreg + 3, CycleCount + 1); IntP->Cancel(INT_NMI);}
 	}
 }
 
@@ -271,6 +282,8 @@ void BRK__(){
 		case 5: PC = DtBuf; PC = PC << 8;
 				AdBuf = 0xfffe; break;
 		case 6: PC = PC + DtBuf; cycle = -1;      
+				if(CallP != NULL){ CallP->Call(PC, Sreg + 3, CycleCount, CALL_BRK);}
+				if(IntP != NULL){ IntP->Enter(INT_BRK, Sreg + 3, CycleCount + 1);}
 	}
 }
 
@@ -282,6 +295,7 @@ void JSR__(){
 		case 3: PC++; AdBuf = PC; IoBuf = 1; break;
 		case 4: Buff[0] = DtBuf; AdBuf++; break;
 		case 5: PC = (DtBuf << 8) + Buff[0]; cycle = -1;
+				if(CallP != NULL){ CallP->Call(PC, Sreg + 2, CycleCount, CALL_JSR);}
 	}
 }
 
@@ -293,6 +307,8 @@ void RTI__(){
 		case 3: PC = (DtBuf << 8) + Buff[0]; break;
 		case 4: break;
 		case 5: cycle = -1;
+				if(CallP != NULL){ CallP->Return(Sreg, CycleCount);}
+				if(IntP != NULL){ IntP->Return(Sreg, CycleCount + 1);}
 	}
 }
 
@@ -303,6 +319,7 @@ void RTS__(){
 		case 2: PC = (DtBuf << 8) + Buff[0]; break;
 		case 3: break;
 		case 4: PC++; cycle = -1;
+				if(CallP != NULL){ CallP->Return(Sreg, CycleCount);}
 	}
 }
 
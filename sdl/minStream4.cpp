@@ -5,6 +5,7 @@ and may not be redistributed without written permission.*/
 
 #include <SDL.h>
 #include <stdio.h>
+#include <string.h>
 #include <string>
 
 #include "minStream4.h"
@@ -57,14 +58,22 @@ bool limitfpsSDL(unsigned int fps){
 }
 
 
-void* getptrSDL(SDL_Texture** mTexture){
+void* getptrSDL(SDL_Texture** mTexture, int* pitch, const SDL_Rect* area){
 	
-	void* mPixels = NULL; int mPitch;
+	void* mPixels = NULL; int mPitch = 0;
 	
-	SDL_LockTexture( *mTexture, NULL, &mPixels, &mPitch );
+	SDL_LockTexture( *mTexture, area, &mPixels, &mPitch );
 	// After this, mPixel will point to memory area I can write my data to!
-		
-	return mPixels;   // mPixels points to Uchar32: ABGR color order
+	// Lines are mPitch bytes apart, that's the driver's choice and can be more than width*4
+	
+	if(pitch != NULL){ *pitch = mPitch;}
+	return mPixels;   // mPixels points to Uchar32: ABGR color order (first pixel of area)
+}
+
+
+void unlockSDL(SDL_Texture** mTexture){
+	
+	SDL_UnlockTexture( *mTexture );
 }
 
 
@@ -88,3 +97,37 @@ void renderSDL(SDL_Texture** mTexture, int Xpos, int Ypos, int Xlen, int Ylen, S
 
 
 
+
+
+void updateSDL(SDL_Texture** mTexture, int x, int y, int w, int h, const void* pixels, int pitch){
+	
+	SDL_Rect Area = { x, y, w, h };
+	int mPitch;
+	
+	char* dst = (char*)getptrSDL( mTexture, &mPitch, &Area );        // straight into the texture memory
+	const char* src = (const char*)pixels;                          // pixels points to the first pixel of the area
+	if(dst == NULL){ return;}
+	
+	if(mPitch == pitch && w*4 == pitch){ memcpy( dst, src, pitch*h );}   // packed on both sides
+	else{
+		for(int i = 0; i < h; i++, dst += mPitch, src += pitch){ memcpy( dst, src, w*4 );}
+	}
+	unlockSDL( mTexture );
+}
+
+
+void presentSDL(SDL_Texture** mTexture, int Xpos, int Ypos, int Xlen, int Ylen, SDL_Renderer** gRenderer){
+	
+	//Render frame (texture is not locked)
+	SDL_Rect renderQuad = { Xpos, Ypos, Xlen, Ylen };
+	SDL_RenderCopyEx( *gRenderer, *mTexture, NULL, &renderQuad, 0.0, NULL, SDL_FLIP_NONE);
+
+	//Update screen
+	SDL_RenderPresent( *gRenderer );
+}
+
+
+void titleSDL(SDL_Window** gWindow, const char* title){
+	
+	SDL_SetWindowTitle( *gWindow, title );
+}
@@ -9,10 +9,18 @@ void clearwinSDL(SDL_Renderer** gRenderer, Uint32 Col);
 
 bool limitfpsSDL(unsigned int fps);
 
-void* getptrSDL(SDL_Texture** mTexture);
+void* getptrSDL(SDL_Texture** mTexture, int* pitch = NULL, const SDL_Rect* area = NULL);
+
+void unlockSDL(SDL_Texture** mTexture);
 
 void renderSDL(SDL_Texture** mTexture, int Xpos, int Ypos, int Xlen, int Ylen, SDL_Renderer** gRenderer);
 
+void updateSDL(SDL_Texture** mTexture, int x, int y, int w, int h, const void* pixels, int pitch);
+
+void presentSDL(SDL_Texture** mTexture, int Xpos, int Ypos, int Xlen, int Ylen, SDL_Renderer** gRenderer);
+
+void titleSDL(SDL_Window** gWindow, const char* title);
+
 #endif
 
 /*
@@ -43,11 +51,14 @@ int main(){
 			if( e.type == SDL_QUIT ){ quit = true;}       // If user requests quit
 		}
 
-		void* vi = getptrSDL( &mTexture );                // Lock texture and get data pointer
+		int pitch;
+		void* vi = getptrSDL( &mTexture, &pitch );        // Lock texture and get data pointer
 		//char *ui = (char*)vi;                           // In case you want to write to memory directly
 		
 		MyFrame[hk] = 0x50; hk++;	
-		memcpy( vi, MyFrame, 65536 );
+		for(int y = 0; y < 128; y++){                     // lines can be longer than 128*4 bytes (driver pitch)
+			memcpy( (char*)vi + y*pitch, MyFrame + y*512, 512 );
+		}
 		
 		renderSDL( &mTexture, 50, 50, 128, 128, &gRenderer );    // unlock and render
 		
@@ -60,6 +71,15 @@ int main(){
 	return 0;
 }
 
+======================= PARTIAL UPDATES =======================
+
+	// only the changed rectangle of the frame is uploaded (locked and copied line by line)
+	
+	updateSDL( &mTexture, 10, 20, 8, 8, MyFrame + (20*128 + 10)*4, 128*4 );
+	presentSDL( &mTexture, 50, 50, 128, 128, &gRenderer );       // render without unlocking
+	
+	titleSDL( &gWindow, "12.5 fps" );                             // status text in the title bar
+
 =======================================================
 */
 
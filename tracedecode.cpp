@@ -0,0 +1,64 @@
+#include <iostream>
+#include <cstring>
+
+#include "mylib/DeviceLibrary.cpp"
+#include "mylib/Disasm_6502.cpp"
+
+// Prints a binary instruction trace (TraceBuffer::Save, headless --trace) as text, one
+// instruction per line: cycle, address, bytes, disassembly, registers before it, data access.
+//
+//   g++ -O2 -o tracedecode tracedecode.cpp
+//   tracedecode TRACE [--last N]
+
+using namespace std;
+
+const char *KindName[] = { "", "NMI", "IRQ", "RESET" };
+
+
+int main(int argc, char *argv[]){
+
+	unsigned long long Last = 0;
+	const char *Path = NULL;
+
+	for(int i = 1; i < argc; i++){
+		string o = argv[i];
+		if(o == "--last" && i + 1 < argc){ Last = strtoull(argv[++i], NULL, 10);}
+		else if(Path == NULL && o[0] != '-'){ Path = argv[i];}
+		else{ Path = NULL; break;}
+	}
+	if(Path == NULL){ printf("tracedecode TRACE [--last N]\n"); return 2;}
+
+	ifstream fin(Path, ios::in | ios::binary);
+	char magic[4]; uint32_t size = 0; unsigned long long total = 0;
+	fin.read(magic, 4);
+	fin.read(reinterpret_cast<char*>(&size), 4);
+	fin.read(reinterpret_cast<char*>(&total), 8);
+	if(!fin || memcmp(magic, "TRC1", 4) != 0 || size != sizeof(TraceRecord)){ printf("%s: not a trace file\n", Path); return 1;}
+
+	fin.seekg(0, ios::end);
+	unsigned long long n = (unsigned long long)(fin.tellg() - streamoff(16)) / size, skip = 0;
+	if(Last != 0 && Last < n){ skip = n - Last;}
+	fin.seekg(16 + skip*size);
+
+	printf("; %llu instructions traced, %llu in the file, showing %llu\n", total, n, n - skip);
+
+	TraceRecord r;
+	unsigned long long high = 0; uint32_t prev = 0;                   // cycle counts are stored with 32 bits
+	char text[32], bytes[16];
+	for(unsigned long long i = skip; i < n && fin.read(reinterpret_cast<char*>(&r), size); i++){
+		if(i != skip && r.Cycle < prev){ high += 1ULL << 32;}
+		prev = r.Cycle;
+
+		uint8_t b[3] = { r.Op, r.Arg1, r.Arg2 };
+		int len = Disasm6502(r.PC, b, text);
+		if(len == 1){ snprintf(bytes, 16, "%02X", r.Op);}
+		if(len == 2){ snprintf(bytes, 16, "%02X %02X", r.Op, r.Arg1);}
+		if(len == 3){ snprintf(bytes, 16, "%02X %02X %02X", r.Op, r.Arg1, r.Arg2);}
+		if((r.Kind & 3) != 0){ snprintf(text, 32, "<%s>", KindName[r.Kind & 3]); bytes[0] = 0;}
+
+		printf("%10llu  %04X  %-9s %-16s A=%02X X=%02X Y=%02X S=%02X P=%02X", high + r.Cycle, r.PC, bytes, text, r.A, r.X, r.Y, r.S, r.P);
+		if(r.Kind & TRACE_EA){ printf("  %s $%04X", (r.Kind & TRACE_WRITE) ? "W" : "R", r.EA);}
+		printf("\n");
+	}
+	return 0;
+}